@@ -158,4 +158,29 @@
 /* 32 Bit Integer, 2 values, horizontal hysteresis, vertical hysteresis */
 #define SYNAPTICS_PROP_NOISE_CANCELLATION "Synaptics Noise Cancellation"
 
+/* 32 bit, 7 values, vertical scroll width, horizontal scroll height,
+ * button area top, middle button top, middle button bottom, middle button
+ * width, modifier radius */
+#define SYNAPTICS_PROP_REGION_LAYOUT "Synaptics Region Layout"
+
+/* 8 bit (BOOL), record per-report input latency */
+#define SYNAPTICS_PROP_LATENCY_TRACE "Synaptics Latency Trace"
+
+/* 32 bit unsigned, 9 values (read-only), in microseconds:
+ * kernel to driver p50, p99, max, driver to posted event p50, p99, max,
+ * total p50, p99, max */
+#define SYNAPTICS_PROP_LATENCY "Synaptics Latency"
+
+/* 32 bit unsigned (read-only), number of reports in which a finger moved
+ * further than MaxDeltaMM and was rebased instead of moving the pointer */
+#define SYNAPTICS_PROP_JUMPS "Synaptics Jumps Filtered"
+
+/* FLOAT, up to 16 pairs of velocity and gain, the acceleration curve
+ * through these points. Velocities strictly increasing, gains positive and
+ * not decreasing. No values to derive the curve from Synaptics Move Speed */
+#define SYNAPTICS_PROP_ACCEL_CURVE "Synaptics Acceleration Curve"
+
+/* 32 bit, milliseconds to extrapolate pointer motion ahead, 0 to disable */
+#define SYNAPTICS_PROP_PREDICTION "Synaptics Motion Prediction"
+
 #endif                          /* _SYNAPTICS_PROPERTIES_H_ */
@@ -38,6 +38,7 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <string.h>
+#include <unistd.h>
 #include <stdio.h>
 #include <time.h>
 #include "synproto.h"
@@ -70,6 +71,9 @@
 #define ABS_MT_MAX ABS_MT_TOOL_Y
 #define ABS_MT_CNT (ABS_MT_MAX - ABS_MT_MIN + 1)
 
+/* Events read from the device in one go, enough for a full 5-finger frame */
+#define EVENT_BUFFER_SIZE 64
+
 /**
  * Protocol-specific data.
  */
@@ -84,13 +88,18 @@ struct eventcomm_proto_data {
     double st_to_mt_scale[2];
     int axis_map[ABS_MT_CNT];
     int cur_slot;
+    int width_code;             /* contact size axis, -1 if there is none */
     ValuatorMask **last_mt_vals;
     int num_touches;
 
     struct libevdev *evdev;
-    enum libevdev_read_flag read_flag;
 
     int have_monotonic_clock;
+
+    /* Events are read straight from the fd in bulk and decoded from here.
+       libevdev is only used to resync after a SYN_DROPPED. */
+    struct input_event events[EVENT_BUFFER_SIZE];
+    int events_head, events_tail;
 };
 
 #ifdef HAVE_LIBEVDEV_DEVICE_LOG_FUNCS
@@ -154,8 +163,6 @@ EventProtoDataAlloc(int fd)
         goto out;
     }
 
-    proto_data->read_flag = LIBEVDEV_READ_FLAG_NORMAL;
-
 out:
     if (rc < 0) {
         if (proto_data && proto_data->evdev)
@@ -196,6 +203,15 @@ InitializeTouch(InputInfoPtr pInfo)
     proto_data->cur_slot = libevdev_get_current_slot(proto_data->evdev);
     proto_data->num_touches = 0;
 
+    priv->num_slots = libevdev_get_num_slots(proto_data->evdev);
+    if (priv->num_slots > SYNAPTICS_MAX_TOUCHES) {
+        xf86IDrvMsg(pInfo, X_INFO, "device has %d touch slots, tracking %d\n",
+                    priv->num_slots, SYNAPTICS_MAX_TOUCHES);
+        priv->num_slots = SYNAPTICS_MAX_TOUCHES;
+    }
+    else if (priv->num_slots < 1)
+        priv->num_slots = 1;
+
     if (!proto_data->last_mt_vals) {
         xf86IDrvMsg(pInfo, X_WARNING,
                     "failed to allocate MT last values mask array\n");
@@ -228,6 +244,7 @@ EventDeviceOnHook(InputInfoPtr pInfo, SynapticsParameters * para)
 
     } else
         libevdev_set_fd(proto_data->evdev, pInfo->fd);
+    proto_data->events_head = proto_data->events_tail = 0;
 
 
     if (para->grab_event_device) {
@@ -362,79 +379,135 @@ EventQueryHardware(InputInfoPtr pInfo)
     return TRUE;
 }
 
+/**
+ * Refill the event buffer with a single read(2). The kernel only ever
+ * returns whole events, but a frame may be split across two reads.
+ *
+ * @return FALSE if no events are pending.
+ */
 static Bool
-SynapticsReadEvent(InputInfoPtr pInfo, struct input_event *ev)
+EventFillBuffer(InputInfoPtr pInfo, struct eventcomm_proto_data *proto_data)
 {
-    SynapticsPrivate *priv = (SynapticsPrivate *) pInfo->private;
-    struct eventcomm_proto_data *proto_data = priv->proto_data;
-    int rc;
-    static struct timeval last_event_time;
-
-    rc = libevdev_next_event(proto_data->evdev, proto_data->read_flag, ev);
-    if (rc < 0) {
-        if (rc != -EAGAIN) {
-            LogMessageVerbSigSafe(X_ERROR, 0, "%s: Read error %d\n", pInfo->name,
-                    errno);
-        } else if (proto_data->read_flag == LIBEVDEV_READ_FLAG_SYNC) {
-            proto_data->read_flag = LIBEVDEV_READ_FLAG_NORMAL;
-            return SynapticsReadEvent(pInfo, ev);
-        }
-
+    ssize_t len;
+
+    SYSCALL(len = read(pInfo->fd, proto_data->events,
+                       sizeof(proto_data->events)));
+    if (len <= 0) {
+        if (len < 0 && errno != EAGAIN)
+            LogMessageVerbSigSafe(X_ERROR, 0, "%s: Read error %d\n",
+                                  pInfo->name, errno);
         return FALSE;
     }
 
-    /* SYN_DROPPED received in normal mode. Create a normal EV_SYN
-       so we process what's in the queue atm, then ensure we sync
-       next time */
-    if (rc == LIBEVDEV_READ_STATUS_SYNC &&
-        proto_data->read_flag == LIBEVDEV_READ_FLAG_NORMAL) {
-        proto_data->read_flag = LIBEVDEV_READ_FLAG_SYNC;
-        ev->type = EV_SYN;
-        ev->code = SYN_REPORT;
-        ev->value = 0;
-        ev->time = last_event_time;
-    } else if (ev->type == EV_SYN)
-        last_event_time = ev->time;
-
+    proto_data->events_head = 0;
+    proto_data->events_tail = len / sizeof(struct input_event);
     return TRUE;
 }
 
+/**
+ * Recover from a SYN_DROPPED. Anything still buffered is stale, so throw
+ * it away, let libevdev drain the fd and query the kernel state, and
+ * rebuild the touch state from libevdev instead of replaying its deltas.
+ */
+static void
+EventResyncHwState(InputInfoPtr pInfo, struct SynapticsHwState *hw)
+{
+    SynapticsPrivate *priv = (SynapticsPrivate *) pInfo->private;
+    struct eventcomm_proto_data *proto_data = priv->proto_data;
+    struct libevdev *evdev = proto_data->evdev;
+    struct input_event ev;
+    int slot, num_slots;
+
+    proto_data->events_head = proto_data->events_tail = 0;
+
+    libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_FORCE_SYNC, &ev);
+    while (libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_SYNC, &ev) ==
+           LIBEVDEV_READ_STATUS_SYNC)
+        ;
+
+    hw->pressed = libevdev_get_event_value(evdev, EV_KEY, BTN_MOUSE);
+    hw->fingersCount = 0;
+
+    /* anything may have changed while events were being dropped */
+    hw->dirty = (1U << hw->num_slots) - 1;
+    num_slots = libevdev_get_num_slots(evdev);
+    for (slot = 0; slot < hw->num_slots; slot++) {
+        if (slot < num_slots &&
+            libevdev_get_slot_value(evdev, slot, ABS_MT_TRACKING_ID) >= 0) {
+            hw->finger[slot] = 1;
+            hw->fingersCount++;
+            hw->x[slot] = libevdev_get_slot_value(evdev, slot, ABS_MT_POSITION_X);
+            hw->y[slot] = libevdev_get_slot_value(evdev, slot, ABS_MT_POSITION_Y);
+            hw->z[slot] = libevdev_get_slot_value(evdev, slot, ABS_MT_PRESSURE);
+            hw->w[slot] = proto_data->width_code < 0 ? -1 :
+                libevdev_get_slot_value(evdev, slot, proto_data->width_code);
+        }
+        else {
+            hw->finger[slot] = 0;
+            hw->x[slot] = -1;
+            hw->y[slot] = -1;
+            hw->z[slot] = -1;
+            hw->w[slot] = -1;
+        }
+    }
+
+    proto_data->cur_slot = libevdev_get_current_slot(evdev);
+}
 
 Bool
 EventReadHwState(InputInfoPtr pInfo,
                  struct CommData *comm, struct SynapticsHwState *hwRet)
 {
-    struct input_event ev;
-    Bool v;
     struct SynapticsHwState *hw = comm->hwState;
     SynapticsPrivate *priv = (SynapticsPrivate *) pInfo->private;
-    SynapticsParameters *para = &priv->synpara;
     struct eventcomm_proto_data *proto_data = priv->proto_data;
+    int slot = proto_data->cur_slot;
+
+    for (;;) {
+        const struct input_event *ev;
 
+        if (proto_data->events_head == proto_data->events_tail &&
+            !EventFillBuffer(pInfo, proto_data))
+            break;
 
-    while (SynapticsReadEvent(pInfo, &ev)) {
-        switch (ev.type) {
+        ev = &proto_data->events[proto_data->events_head++];
+
+        switch (ev->type) {
         case EV_SYN:
-            switch (ev.code) {
+            switch (ev->code) {
+            case SYN_DROPPED:
+                proto_data->cur_slot = slot;
+                EventResyncHwState(pInfo, hw);
+                slot = proto_data->cur_slot;
+                /* fall through, report the resynced state */
             case SYN_REPORT:
                 if (proto_data->have_monotonic_clock)
-                    hw->millis = 1000 * ev.time.tv_sec + ev.time.tv_usec / 1000;
+                    hw->usec = 1000000ULL * ev->time.tv_sec + ev->time.tv_usec;
                 else
-                    hw->millis = GetTimeInMillis();
+                    hw->usec = GetTimeInMicros();
+                hw->millis = hw->usec / 1000;
+                proto_data->cur_slot = slot;
                 SynapticsCopyHwState(hwRet, hw);
+                hw->dirty = 0;
                 return TRUE;
             }
             break;
         case EV_KEY:
-        	if(ev.code==BTN_MOUSE)
+        	if(ev->code==BTN_MOUSE)
         	{
-        		hw->pressed=ev.value;
+        		hw->pressed=ev->value;
         	}
                 break;
 
 
         case EV_ABS:
-                switch (ev.code) {
+                /* ignore slots beyond what we track */
+                if (ev->code > ABS_MT_SLOT &&
+                    (slot < 0 || slot >= hw->num_slots))
+                    break;
+                if (ev->code > ABS_MT_SLOT)
+                    hw->dirty |= 1U << slot;
+                switch (ev->code) {
                 case ABS_X:
                     break;
                 case ABS_Y:
@@ -442,30 +515,36 @@ EventReadHwState(InputInfoPtr pInfo,
                 case ABS_PRESSURE:
                     break;
                 case ABS_MT_SLOT:
-                    proto_data->cur_slot=ev.value;
+                    slot=ev->value;
                 	break;
                 case ABS_MT_TRACKING_ID:
-                    if(ev.value<0){
-                    	hw->finger[proto_data->cur_slot]=0;
+                    if(ev->value<0){
+                    	hw->finger[slot]=0;
                     	hw->fingersCount--;
-                    	hw->x[proto_data->cur_slot]=-1;
-                    	hw->y[proto_data->cur_slot]=-1;
-                    	hw->z[proto_data->cur_slot]=-1;
+                    	hw->x[slot]=-1;
+                    	hw->y[slot]=-1;
+                    	hw->z[slot]=-1;
+                    	hw->w[slot]=-1;
                     }
                     else{
-                    	hw->finger[proto_data->cur_slot]=1;
+                    	hw->finger[slot]=1;
                     	hw->fingersCount++;
                     }
                 	break;
                 case ABS_MT_POSITION_X:
-                	hw->x[proto_data->cur_slot]=ev.value;
+                	hw->x[slot]=ev->value;
                 	break;
                 case ABS_MT_POSITION_Y:
-                	hw->y[proto_data->cur_slot]=ev.value;
+                	hw->y[slot]=ev->value;
                 	break;
                 case ABS_MT_PRESSURE:
-                	hw->z[proto_data->cur_slot]=ev.value;
+                	hw->z[slot]=ev->value;
                 	break;
+                case ABS_MT_TOUCH_MAJOR:
+                case ABS_MT_WIDTH_MAJOR:
+                    if (ev->code == proto_data->width_code)
+                        hw->w[slot] = ev->value;
+                    break;
                 default:
 //                    xf86DrvMsg(pInfo, X_PROBED, "Unknown packet %d = %d\n",ev.code,ev.value);
                 	break;
@@ -473,6 +552,7 @@ EventReadHwState(InputInfoPtr pInfo,
             break;
         }
     }
+    proto_data->cur_slot = slot;
     return FALSE;
 }
 
@@ -501,12 +581,35 @@ EventReadDevDimensions(InputInfoPtr pInfo)
 
     proto_data = EventProtoDataAlloc(pInfo->fd);
     priv->proto_data = proto_data;
+    if (!proto_data)
+        return;
 
     for (i = 0; i < ABS_MT_CNT; i++)
         proto_data->axis_map[i] = -1;
     proto_data->cur_slot = -1;
 
-
+    /* the driver only looks at MT positions, so use their ranges */
+    if (libevdev_has_event_code(proto_data->evdev, EV_ABS, ABS_MT_POSITION_X))
+        event_get_abs(proto_data->evdev, ABS_MT_POSITION_X, &priv->minx,
+                      &priv->maxx, NULL, &priv->resx);
+    if (libevdev_has_event_code(proto_data->evdev, EV_ABS, ABS_MT_POSITION_Y))
+        event_get_abs(proto_data->evdev, ABS_MT_POSITION_Y, &priv->miny,
+                      &priv->maxy, NULL, &priv->resy);
+    if (libevdev_has_event_code(proto_data->evdev, EV_ABS, ABS_MT_PRESSURE))
+        event_get_abs(proto_data->evdev, ABS_MT_PRESSURE, &priv->minp,
+                      &priv->maxp, NULL, NULL);
+
+    /* the contact size, the touch itself rather than the tool if both */
+    if (libevdev_has_event_code(proto_data->evdev, EV_ABS, ABS_MT_TOUCH_MAJOR))
+        proto_data->width_code = ABS_MT_TOUCH_MAJOR;
+    else if (libevdev_has_event_code(proto_data->evdev, EV_ABS,
+                                     ABS_MT_WIDTH_MAJOR))
+        proto_data->width_code = ABS_MT_WIDTH_MAJOR;
+    else
+        proto_data->width_code = -1;
+    if (proto_data->width_code >= 0)
+        event_get_abs(proto_data->evdev, proto_data->width_code, &priv->minw,
+                      &priv->maxw, NULL, NULL);
 }
 static Bool
 EventAutoDevProbe(InputInfoPtr pInfo, const char *device)
@@ -30,6 +30,8 @@
 #include <xorg-server.h>
 #include "xf86Module.h"
 
+#include <math.h>
+#include <stddef.h>
 #include <X11/Xatom.h>
 #include <xf86.h>
 #include <xf86Xinput.h>
@@ -96,6 +98,12 @@ Atom prop_secondary_softbutton_areas = 0;
 Atom prop_noise_cancellation = 0;
 Atom prop_product_id = 0;
 Atom prop_device_node = 0;
+Atom prop_region_layout = 0;
+Atom prop_latency_trace = 0;
+Atom prop_latency = 0;
+Atom prop_jumps = 0;
+Atom prop_accel_curve = 0;
+Atom prop_prediction = 0;
 
 static Atom
 InitTypedAtom(DeviceIntPtr dev, char *name, Atom type, int format, int nvalues,
@@ -161,6 +169,413 @@ InitFloatAtom(DeviceIntPtr dev, char *name, int nvalues, float *values)
 }
 
 
+/*
+ * Property dispatch. Every property the driver accepts has a descriptor
+ * giving the format, number of values and type it must have, an optional
+ * validator for the values and either an applier or the parameters the
+ * values are stored in, in order, and the derived tables built from those
+ * parameters. SetProperty finds the descriptor through an index keyed by
+ * atom, so the cost doesn't depend on the property.
+ */
+
+#define PROP_READ_ONLY 0        /* format of properties clients can't set */
+#define PROP_MAX_FIELDS 7
+#define PROP_INDEX_SIZE 128     /* power of two, well above the number of properties */
+
+#define PARAM(field) offsetof(SynapticsParameters, field)
+
+enum SynapticsPropType {
+    PT_INTEGER,
+    PT_CARDINAL,
+    PT_FLOAT,                   /* stored in double parameters */
+};
+
+typedef struct _SynapticsPropDesc {
+    Atom *atom;
+    int format;
+    int size;                   /* number of values, 0 if checked by validate */
+    enum SynapticsPropType type;
+    unsigned int rebuild;       /* SYN_DERIVED_* tables built from it */
+    int (*validate) (const void *data, int size);
+    void (*apply) (DeviceIntPtr dev, SynapticsPrivate * priv,
+                   const void *data, int size);
+    int nfields;                /* parameters set from the first values */
+    size_t fields[PROP_MAX_FIELDS];
+} SynapticsPropDescRec;
+
+static int
+ValidateEdges(const void *data, int size)
+{
+    const INT32 *edges = data;
+
+    if (edges[0] > edges[1] || edges[2] > edges[3])
+        return BadValue;
+    return Success;
+}
+
+static int
+ValidateFinger(const void *data, int size)
+{
+    const INT32 *finger = data;
+
+    return finger[0] > finger[1] ? BadValue : Success;
+}
+
+static int
+ValidateScrollDistance(const void *data, int size)
+{
+    const INT32 *dist = data;
+
+    return dist[0] == 0 || dist[1] == 0 ? BadValue : Success;
+}
+
+static void
+ApplyScrollDistance(DeviceIntPtr dev, SynapticsPrivate * priv,
+                    const void *data, int size)
+{
+    SynapticsParameters *para = &priv->synpara;
+    const INT32 *dist = data;
+
+    if (para->scroll_dist_vert != dist[0]) {
+        para->scroll_dist_vert = dist[0];
+        SetScrollValuator(dev, priv->scroll_axis_vert, SCROLL_TYPE_VERTICAL,
+                          para->scroll_dist_vert, 0);
+    }
+    if (para->scroll_dist_horiz != dist[1]) {
+        para->scroll_dist_horiz = dist[1];
+        SetScrollValuator(dev, priv->scroll_axis_horiz,
+                          SCROLL_TYPE_HORIZONTAL, para->scroll_dist_horiz, 0);
+    }
+}
+
+static int
+ValidateSpeed(const void *data, int size)
+{
+    const float *speed = data;
+
+    /* written so NaN fails too */
+    if (!(speed[0] > 0) || !(speed[1] >= speed[0]) || !(speed[2] >= 0))
+        return BadValue;
+    return Success;
+}
+
+static int
+ValidateAccelCurve(const void *data, int size)
+{
+    const float *points = data;
+    int i;
+
+    if (size % 2 || size > 2 * SYN_ACCEL_MAX_POINTS)
+        return BadMatch;
+
+    for (i = 0; i < size / 2; i++) {
+        float velocity = points[2 * i], gain = points[2 * i + 1];
+
+        if (!isfinite(velocity) || !isfinite(gain) || gain <= 0)
+            return BadValue;
+        if (i == 0 ? velocity < 0 :
+            velocity <= points[2 * i - 2] || gain < points[2 * i - 1])
+            return BadValue;
+    }
+    return Success;
+}
+
+static void
+ApplyAccelCurve(DeviceIntPtr dev, SynapticsPrivate * priv,
+                const void *data, int size)
+{
+    priv->synpara.accel_npoints = size / 2;
+    memcpy(priv->synpara.accel_points, data, size * sizeof(float));
+}
+
+static int
+ValidateOff(const void *data, int size)
+{
+    return *(const CARD8 *) data > 2 ? BadValue : Success;
+}
+
+static int
+ValidateCircScrollDistance(const void *data, int size)
+{
+    return *(const float *) data == 0 ? BadValue : Success;
+}
+
+static int
+ValidateCircScrollTrigger(const void *data, int size)
+{
+    return *(const CARD8 *) data > 8 ? BadValue : Success;
+}
+
+static int
+ValidatePressureMotion(const void *data, int size)
+{
+    const CARD32 *press = data;
+
+    return press[0] > press[1] ? BadValue : Success;
+}
+
+static int
+ValidatePressureMotionFactor(const void *data, int size)
+{
+    const float *press = data;
+
+    return press[0] > press[1] ? BadValue : Success;
+}
+
+static int
+ValidateArea(const void *data, int size)
+{
+    const INT32 *area = data;
+
+    if ((((area[0] != 0) && (area[1] != 0)) && (area[0] > area[1])) ||
+        (((area[2] != 0) && (area[3] != 0)) && (area[2] > area[3])))
+        return BadValue;
+    return Success;
+}
+
+static int
+ValidateSoftButtonAreas(const void *data, int size)
+{
+    return SynapticsIsSoftButtonAreasValid((int *) data) ? Success : BadValue;
+}
+
+static int
+ValidateNoiseCancellation(const void *data, int size)
+{
+    const INT32 *hyst = data;
+
+    return hyst[0] < 0 || hyst[1] < 0 ? BadValue : Success;
+}
+
+static int
+ValidateRegionLayout(const void *data, int size)
+{
+    const INT32 *layout = data;
+    int i;
+
+    for (i = 0; i < 7; i++)
+        if (layout[i] < 0)
+            return BadValue;
+    return layout[3] > layout[4] ? BadValue : Success;
+}
+
+static void
+ApplyLatencyTrace(DeviceIntPtr dev, SynapticsPrivate * priv,
+                  const void *data, int size)
+{
+    BOOL trace = *(const BOOL *) data;
+
+    /* start every trace with fresh statistics */
+    if (trace && !priv->synpara.latency_trace)
+        SynapticsLatencyReset(&priv->latency);
+    priv->synpara.latency_trace = trace;
+}
+
+static int
+ValidatePrediction(const void *data, int size)
+{
+    INT32 horizon = *(const INT32 *) data;
+
+    if (horizon < 0 || horizon > SYN_MAX_PREDICT_HORIZON)
+        return BadValue;
+    return Success;
+}
+
+/* Earlier entries win if two share an atom */
+static const SynapticsPropDescRec prop_descs[] = {
+    {&prop_edges, 32, 4, PT_INTEGER, 0, ValidateEdges, NULL,
+     4, {PARAM(left_edge), PARAM(right_edge), PARAM(top_edge),
+         PARAM(bottom_edge)}},
+    {&prop_finger, 32, 3, PT_INTEGER, 0, ValidateFinger, NULL,
+     2, {PARAM(finger_low), PARAM(finger_high)}},
+    {&prop_tap_time, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(tap_time)}},
+    {&prop_tap_move, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(tap_move)}},
+    {&prop_tap_durations, 32, 3, PT_INTEGER, 0, NULL, NULL,
+     3, {PARAM(single_tap_timeout), PARAM(tap_time_2), PARAM(click_time)}},
+    {&prop_clickpad, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(clickpad)}},
+    {&prop_middle_timeout, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(emulate_mid_button_time)}},
+    {&prop_twofinger_pressure, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(emulate_twofinger_z)}},
+    {&prop_twofinger_width, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(emulate_twofinger_w)}},
+    {&prop_scrolldist, 32, 2, PT_INTEGER, 0, ValidateScrollDistance,
+     ApplyScrollDistance},
+    {&prop_scrolledge, 8, 3, PT_INTEGER, 0, NULL, NULL,
+     3, {PARAM(scroll_edge_vert), PARAM(scroll_edge_horiz),
+         PARAM(scroll_edge_corner)}},
+    {&prop_scrolltwofinger, 8, 2, PT_INTEGER, 0, NULL, NULL,
+     2, {PARAM(scroll_twofinger_vert), PARAM(scroll_twofinger_horiz)}},
+    {&prop_speed, 32, 4, PT_FLOAT, SYN_DERIVED_ACCEL, ValidateSpeed, NULL,
+     3, {PARAM(min_speed), PARAM(max_speed), PARAM(accl)}},
+    {&prop_accel_curve, 32, 0, PT_FLOAT, SYN_DERIVED_ACCEL,
+     ValidateAccelCurve, ApplyAccelCurve},
+    {&prop_off, 8, 1, PT_INTEGER, 0, ValidateOff, NULL,
+     1, {PARAM(touchpad_off)}},
+    {&prop_gestures, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(tap_and_drag_gesture)}},
+    {&prop_lockdrags, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(locked_drags)}},
+    {&prop_lockdrags_time, 32, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(locked_drag_time)}},
+    {&prop_circscroll, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(circular_scrolling)}},
+    {&prop_circscroll_dist, 32, 1, PT_FLOAT, 0, ValidateCircScrollDistance,
+     NULL, 1, {PARAM(scroll_dist_circ)}},
+    {&prop_circscroll_trigger, 8, 1, PT_INTEGER, 0, ValidateCircScrollTrigger,
+     NULL, 1, {PARAM(circular_trigger)}},
+    {&prop_circpad, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(circular_pad)}},
+    {&prop_palm, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(palm_detect)}},
+    {&prop_palm_dim, 32, 2, PT_INTEGER, 0, NULL, NULL,
+     2, {PARAM(palm_min_width), PARAM(palm_min_z)}},
+    {&prop_coastspeed, 32, 2, PT_FLOAT, 0, NULL, NULL,
+     2, {PARAM(coasting_speed), PARAM(coasting_friction)}},
+    {&prop_pressuremotion, 32, 2, PT_CARDINAL, SYN_DERIVED_PRESSURE,
+     ValidatePressureMotion, NULL,
+     2, {PARAM(press_motion_min_z), PARAM(press_motion_max_z)}},
+    {&prop_pressuremotion_factor, 32, 2, PT_FLOAT, SYN_DERIVED_PRESSURE,
+     ValidatePressureMotionFactor, NULL,
+     2, {PARAM(press_motion_min_factor), PARAM(press_motion_max_factor)}},
+    {&prop_resolution_detect, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(resolution_detect)}},
+    {&prop_grab, 8, 1, PT_INTEGER, 0, NULL, NULL,
+     1, {PARAM(grab_event_device)}},
+    {&prop_capabilities, PROP_READ_ONLY},
+    {&prop_resolution, PROP_READ_ONLY},
+    {&prop_area, 32, 4, PT_INTEGER, 0, ValidateArea, NULL,
+     4, {PARAM(area_left_edge), PARAM(area_right_edge),
+         PARAM(area_top_edge), PARAM(area_bottom_edge)}},
+    /* checked, but nothing reads them */
+    {&prop_softbutton_areas, 32, 8, PT_INTEGER, 0, ValidateSoftButtonAreas},
+    {&prop_secondary_softbutton_areas, 32, 8, PT_INTEGER, 0,
+     ValidateSoftButtonAreas},
+    {&prop_noise_cancellation, 32, 2, PT_INTEGER, 0, ValidateNoiseCancellation,
+     NULL, 2, {PARAM(hyst_x), PARAM(hyst_y)}},
+    {&prop_region_layout, 32, 7, PT_INTEGER, SYN_DERIVED_REGIONS,
+     ValidateRegionLayout, NULL,
+     7, {PARAM(vertscroll_width), PARAM(horizscroll_height),
+         PARAM(buttons_top), PARAM(middlebtn_top), PARAM(middlebtn_bottom),
+         PARAM(middlebtn_width), PARAM(modifier_radius)}},
+    {&prop_latency_trace, 8, 1, PT_INTEGER, 0, NULL, ApplyLatencyTrace},
+    {&prop_prediction, 32, 1, PT_INTEGER, 0, ValidatePrediction, NULL,
+     1, {PARAM(predict_horizon)}},
+    {&prop_product_id, PROP_READ_ONLY},
+    {&prop_device_node, PROP_READ_ONLY},
+    {&prop_latency, PROP_READ_ONLY},
+    {&prop_jumps, PROP_READ_ONLY},
+};
+
+/* Open addressing on the atom, which the server hands out in sequence */
+static struct {
+    Atom atom;
+    const SynapticsPropDescRec *desc;
+} prop_index[PROP_INDEX_SIZE];
+
+static void
+PropIndexAdd(const SynapticsPropDescRec *desc)
+{
+    Atom atom = *desc->atom;
+    unsigned int i;
+
+    for (i = atom; prop_index[i % PROP_INDEX_SIZE].atom; i++)
+        if (prop_index[i % PROP_INDEX_SIZE].atom == atom)
+            return;
+    prop_index[i % PROP_INDEX_SIZE].atom = atom;
+    prop_index[i % PROP_INDEX_SIZE].desc = desc;
+}
+
+static const SynapticsPropDescRec *
+PropIndexLookup(Atom atom)
+{
+    unsigned int i;
+
+    for (i = atom; prop_index[i % PROP_INDEX_SIZE].atom; i++)
+        if (prop_index[i % PROP_INDEX_SIZE].atom == atom)
+            return prop_index[i % PROP_INDEX_SIZE].desc;
+    return NULL;
+}
+
+/* The atoms are global, so this is the same for every device */
+static void
+BuildPropertyIndex(void)
+{
+    size_t i;
+
+    memset(prop_index, 0, sizeof(prop_index));
+    for (i = 0; i < sizeof(prop_descs) / sizeof(prop_descs[0]); i++)
+        if (*prop_descs[i].atom)
+            PropIndexAdd(&prop_descs[i]);
+}
+
+static const SynapticsPropDescRec *
+FindPropertyDesc(const Atom *atom)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(prop_descs) / sizeof(prop_descs[0]); i++)
+        if (prop_descs[i].atom == atom)
+            return &prop_descs[i];
+    return NULL;
+}
+
+static int
+CheckProperty(const SynapticsPropDescRec *desc, XIPropertyValuePtr prop)
+{
+    Atom type;
+
+    if (desc->format == PROP_READ_ONLY)
+        return BadValue;
+
+    switch (desc->type) {
+    case PT_CARDINAL:
+        type = XA_CARDINAL;
+        break;
+    case PT_FLOAT:
+        type = float_type;
+        break;
+    case PT_INTEGER:
+    default:
+        type = XA_INTEGER;
+        break;
+    }
+    if ((desc->size && prop->size != desc->size) ||
+        prop->format != desc->format || prop->type != type)
+        return BadMatch;
+
+    return desc->validate ? desc->validate(prop->data, prop->size) : Success;
+}
+
+static void
+ApplyProperty(DeviceIntPtr dev, SynapticsPrivate * priv,
+              const SynapticsPropDescRec *desc, XIPropertyValuePtr prop)
+{
+    char *para = (char *) &priv->synpara;
+    int i;
+
+    if (desc->apply) {
+        desc->apply(dev, priv, prop->data, prop->size);
+        return;
+    }
+
+    for (i = 0; i < desc->nfields; i++) {
+        void *field = para + desc->fields[i];
+
+        if (desc->type == PT_FLOAT)
+            *(double *) field = ((float *) prop->data)[i];
+        else if (desc->format == 8)
+            *(int *) field = ((CARD8 *) prop->data)[i];
+        else if (desc->type == PT_CARDINAL)
+            *(int *) field = ((CARD32 *) prop->data)[i];
+        else
+            *(int *) field = ((INT32 *) prop->data)[i];
+    }
+}
+
 void
 InitDeviceProperties(InputInfoPtr pInfo)
 {
@@ -234,6 +649,9 @@ InitDeviceProperties(InputInfoPtr pInfo)
     fvalues[2] = para->accl;
     fvalues[3] = 0;
     prop_speed = InitFloatAtom(pInfo->dev, SYNAPTICS_PROP_SPEED, 4, fvalues);
+    prop_accel_curve = InitFloatAtom(pInfo->dev, SYNAPTICS_PROP_ACCEL_CURVE,
+                                     2 * para->accel_npoints,
+                                     &para->accel_points[0][0]);
 
 
 
@@ -319,6 +737,32 @@ InitDeviceProperties(InputInfoPtr pInfo)
                                        SYNAPTICS_PROP_NOISE_CANCELLATION, 32, 2,
                                        values);
 
+    values[0] = para->vertscroll_width;
+    values[1] = para->horizscroll_height;
+    values[2] = para->buttons_top;
+    values[3] = para->middlebtn_top;
+    values[4] = para->middlebtn_bottom;
+    values[5] = para->middlebtn_width;
+    values[6] = para->modifier_radius;
+    prop_region_layout =
+        InitAtom(pInfo->dev, SYNAPTICS_PROP_REGION_LAYOUT, 32, 7, values);
+
+    prop_latency_trace =
+        InitAtom(pInfo->dev, SYNAPTICS_PROP_LATENCY_TRACE, 8, 1,
+                 &para->latency_trace);
+
+    prop_prediction =
+        InitAtom(pInfo->dev, SYNAPTICS_PROP_PREDICTION, 32, 1,
+                 &para->predict_horizon);
+
+    memset(values, 0, sizeof(values));
+    prop_latency =
+        InitTypedAtom(pInfo->dev, SYNAPTICS_PROP_LATENCY, XA_CARDINAL, 32,
+                      SYN_LATENCY_NSTATS, values);
+    prop_jumps =
+        InitTypedAtom(pInfo->dev, SYNAPTICS_PROP_JUMPS, XA_CARDINAL, 32, 1,
+                      values);
+
 
 
     if (priv->device) {
@@ -330,6 +774,7 @@ InitDeviceProperties(InputInfoPtr pInfo)
         XISetDevicePropertyDeletable(pInfo->dev, prop_device_node, FALSE);
     }
 
+    BuildPropertyIndex();
 }
 
 int
@@ -338,359 +783,71 @@ SetProperty(DeviceIntPtr dev, Atom property, XIPropertyValuePtr prop,
 {
     InputInfoPtr pInfo = dev->public.devicePrivate;
     SynapticsPrivate *priv = (SynapticsPrivate *) pInfo->private;
-    SynapticsParameters *para = &priv->synpara;
-    SynapticsParameters tmp;
-
-    /* If checkonly is set, no parameters may be changed. So just let the code
-     * change temporary variables and forget about it. */
-    if (checkonly) {
-        tmp = *para;
-        para = &tmp;
-    }
-
-    if (property == prop_edges) {
-        INT32 *edges;
-
-        if (prop->size != 4 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        edges = (INT32 *) prop->data;
-        if (edges[0] > edges[1] || edges[2] > edges[3])
-            return BadValue;
-
-        para->left_edge = edges[0];
-        para->right_edge = edges[1];
-        para->top_edge = edges[2];
-        para->bottom_edge = edges[3];
-
-    }
-    else if (property == prop_finger) {
-        INT32 *finger;
-
-        if (prop->size != 3 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        finger = (INT32 *) prop->data;
-        if (finger[0] > finger[1])
-            return BadValue;
-
-        para->finger_low = finger[0];
-        para->finger_high = finger[1];
-    }
-    else if (property == prop_tap_time) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->tap_time = *(INT32 *) prop->data;
-
-    }
-    else if (property == prop_tap_move) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->tap_move = *(INT32 *) prop->data;
-    }
-    else if (property == prop_tap_durations) {
-        INT32 *timeouts;
-
-        if (prop->size != 3 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        timeouts = (INT32 *) prop->data;
-
-        para->single_tap_timeout = timeouts[0];
-        para->tap_time_2 = timeouts[1];
-        para->click_time = timeouts[2];
-    }
-    else if (property == prop_clickpad) {
-        BOOL value;
-
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        value = *(BOOL *) prop->data;
-
-        para->clickpad = *(BOOL *) prop->data;
-    }
-    else if (property == prop_middle_timeout) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->emulate_mid_button_time = *(INT32 *) prop->data;
-    }
-    else if (property == prop_twofinger_pressure) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->emulate_twofinger_z = *(INT32 *) prop->data;
-    }
-    else if (property == prop_twofinger_width) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->emulate_twofinger_w = *(INT32 *) prop->data;
-    }
-    else if (property == prop_scrolldist) {
-        INT32 *dist;
+    const SynapticsPropDescRec *desc = PropIndexLookup(property);
+    int rc;
 
-        if (prop->size != 2 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
+    /* read-only to clients, not to GetProperty refreshing them */
+    if (desc && desc->format == PROP_READ_ONLY && priv->prop_refresh)
+        return Success;
 
-        dist = (INT32 *) prop->data;
-        if (dist[0] == 0 || dist[1] == 0)
-            return BadValue;
+    if (!desc) {
+        /* the soft button areas are ours once a client creates them */
+        if (strcmp(SYNAPTICS_PROP_SOFTBUTTON_AREAS, NameForAtom(property)) != 0)
+            return Success;
 
-        if (para->scroll_dist_vert != dist[0]) {
-            para->scroll_dist_vert = dist[0];
-            SetScrollValuator(dev, priv->scroll_axis_vert, SCROLL_TYPE_VERTICAL,
-                              para->scroll_dist_vert, 0);
-        }
-        if (para->scroll_dist_horiz != dist[1]) {
-            para->scroll_dist_horiz = dist[1];
-            SetScrollValuator(dev, priv->scroll_axis_horiz,
-                              SCROLL_TYPE_HORIZONTAL, para->scroll_dist_horiz,
-                              0);
+        desc = FindPropertyDesc(&prop_softbutton_areas);
+        rc = CheckProperty(desc, prop);
+        if (rc == Success && !checkonly) {
+            prop_softbutton_areas = property;
+            PropIndexAdd(desc);
+            XISetDevicePropertyDeletable(dev, property, FALSE);
         }
+        return rc;
     }
-    else if (property == prop_scrolledge) {
-        CARD8 *edge;
-
-        if (prop->size != 3 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        edge = (BOOL *) prop->data;
-        para->scroll_edge_vert = edge[0];
-        para->scroll_edge_horiz = edge[1];
-        para->scroll_edge_corner = edge[2];
-    }
-    else if (property == prop_scrolltwofinger) {
-        CARD8 *twofinger;
-
-        if (prop->size != 2 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        twofinger = (BOOL *) prop->data;
-        para->scroll_twofinger_vert = twofinger[0];
-        para->scroll_twofinger_horiz = twofinger[1];
-    }
-    else if (property == prop_speed) {
-        float *speed;
-
-        if (prop->size != 4 || prop->format != 32 || prop->type != float_type)
-            return BadMatch;
-
-        speed = (float *) prop->data;
-        para->min_speed = speed[0];
-        para->max_speed = speed[1];
-        para->accl = speed[2];
-    }
-
-
-    else if (property == prop_off) {
-        CARD8 off;
-
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        off = *(CARD8 *) prop->data;
-
-        if (off > 2)
-            return BadValue;
-
-        para->touchpad_off = off;
-    }
-    else if (property == prop_gestures) {
-        BOOL *gestures;
-
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        gestures = (BOOL *) prop->data;
-        para->tap_and_drag_gesture = gestures[0];
-    }
-    else if (property == prop_lockdrags) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->locked_drags = *(BOOL *) prop->data;
-    }
-    else if (property == prop_lockdrags_time) {
-        if (prop->size != 1 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
 
-        para->locked_drag_time = *(INT32 *) prop->data;
-    }
-
-    else if (property == prop_circscroll) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->circular_scrolling = *(BOOL *) prop->data;
-
-    }
-    else if (property == prop_circscroll_dist) {
-        float circdist;
-
-        if (prop->size != 1 || prop->format != 32 || prop->type != float_type)
-            return BadMatch;
-
-        circdist = *(float *) prop->data;
-        if (circdist == 0)
-            return BadValue;
-
-        para->scroll_dist_circ = circdist;
-    }
-    else if (property == prop_circscroll_trigger) {
-        int trigger;
-
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        trigger = *(CARD8 *) prop->data;
-        if (trigger > 8)
-            return BadValue;
-
-        para->circular_trigger = trigger;
-
-    }
-    else if (property == prop_circpad) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->circular_pad = *(BOOL *) prop->data;
-    }
-    else if (property == prop_palm) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->palm_detect = *(BOOL *) prop->data;
-    }
-    else if (property == prop_palm_dim) {
-        INT32 *dim;
-
-        if (prop->size != 2 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        dim = (INT32 *) prop->data;
-
-        para->palm_min_width = dim[0];
-        para->palm_min_z = dim[1];
-    }
-    else if (property == prop_coastspeed) {
-        float *coast_speeds;
-
-        if (prop->size != 2 || prop->format != 32 || prop->type != float_type)
-            return BadMatch;
-
-        coast_speeds = (float *) prop->data;
-        para->coasting_speed = coast_speeds[0];
-        para->coasting_friction = coast_speeds[1];
-    }
-    else if (property == prop_pressuremotion) {
-        CARD32 *press;
-
-        if (prop->size != 2 || prop->format != 32 || prop->type != XA_CARDINAL)
-            return BadMatch;
-
-        press = (CARD32 *) prop->data;
-        if (press[0] > press[1])
-            return BadValue;
-
-        para->press_motion_min_z = press[0];
-        para->press_motion_max_z = press[1];
-    }
-    else if (property == prop_pressuremotion_factor) {
-        float *press;
+    rc = CheckProperty(desc, prop);
+    if (rc != Success || checkonly)
+        return rc;
+    if (!desc->apply && !desc->nfields)
+        return Success;
 
-        if (prop->size != 2 || prop->format != 32 || prop->type != float_type)
-            return BadMatch;
+    ApplyProperty(dev, priv, desc, prop);
 
-        press = (float *) prop->data;
-        if (press[0] > press[1])
-            return BadValue;
-
-        para->press_motion_min_factor = press[0];
-        para->press_motion_max_factor = press[1];
-    }
-    else if (property == prop_resolution_detect) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->resolution_detect = *(BOOL*)prop->data;
-    }
-    else if (property == prop_grab) {
-        if (prop->size != 1 || prop->format != 8 || prop->type != XA_INTEGER)
-            return BadMatch;
-
-        para->grab_event_device = *(BOOL *) prop->data;
-    }
-    else if (property == prop_capabilities) {
-        /* read-only */
-        return BadValue;
-    }
-    else if (property == prop_resolution) {
-        /* read-only */
-        return BadValue;
-    }
-    else if (property == prop_area) {
-        INT32 *area;
-
-        if (prop->size != 4 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
+    /* hand the change to the input thread */
+    if (!SynapticsPublishConfig(priv, desc->rebuild))
+        return BadAlloc;
 
-        area = (INT32 *) prop->data;
-        if ((((area[0] != 0) && (area[1] != 0)) && (area[0] > area[1])) ||
-            (((area[2] != 0) && (area[3] != 0)) && (area[2] > area[3])))
-            return BadValue;
-
-        para->area_left_edge = area[0];
-        para->area_right_edge = area[1];
-        para->area_top_edge = area[2];
-        para->area_bottom_edge = area[3];
-    }
-    else if (property == prop_softbutton_areas) {
-        int *areas;
+    return Success;
+}
 
-        if (prop->size != 8 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
+/* Replace the values of a read-only property, past SetProperty */
+static void
+RefreshProperty(DeviceIntPtr dev, SynapticsPrivate *priv, Atom property,
+                int nvalues, CARD32 *values)
+{
+    priv->prop_refresh = TRUE;
+    XIChangeDeviceProperty(dev, property, XA_CARDINAL, 32, PropModeReplace,
+                           nvalues, values, FALSE);
+    priv->prop_refresh = FALSE;
+}
 
-        areas = (int *) prop->data;
-        if (!SynapticsIsSoftButtonAreasValid(areas))
-            return BadValue;
-    }
-    else if (property == prop_secondary_softbutton_areas) {
-        int *areas;
+/* Refresh the read-only statistics just before a client reads them */
+int
+GetProperty(DeviceIntPtr dev, Atom property)
+{
+    InputInfoPtr pInfo = dev->public.devicePrivate;
+    SynapticsPrivate *priv = (SynapticsPrivate *) pInfo->private;
 
-        if (prop->size != 8 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
+    if (property == prop_latency) {
+        CARD32 stats[SYN_LATENCY_NSTATS];
 
-        areas = (int *) prop->data;
-        if (!SynapticsIsSoftButtonAreasValid(areas))
-            return BadValue;
+        SynapticsLatencyStats(&priv->latency, stats);
+        RefreshProperty(dev, priv, prop_latency, SYN_LATENCY_NSTATS, stats);
     }
-    else if (property == prop_noise_cancellation) {
-        INT32 *hyst;
-
-        if (prop->size != 2 || prop->format != 32 || prop->type != XA_INTEGER)
-            return BadMatch;
+    else if (property == prop_jumps) {
+        CARD32 jumps = atomic_load_explicit(&priv->jumps, memory_order_relaxed);
 
-        hyst = (INT32 *) prop->data;
-        if (hyst[0] < 0 || hyst[1] < 0)
-            return BadValue;
-        para->hyst_x = hyst[0];
-        para->hyst_y = hyst[1];
-    }
-    else if (property == prop_product_id || property == prop_device_node)
-        return BadValue;        /* read-only */
-    else { /* unknown property */
-        if (strcmp(SYNAPTICS_PROP_SOFTBUTTON_AREAS, NameForAtom(property)) == 0)
-        {
-            prop_softbutton_areas = property;
-            if (SetProperty(dev, property, prop, checkonly) != Success)
-                prop_softbutton_areas = 0;
-            else if (!checkonly)
-                XISetDevicePropertyDeletable(dev, property, FALSE);
-        }
+        RefreshProperty(dev, priv, prop_jumps, 1, &jumps);
     }
 
     return Success;
@@ -1,5 +1,3 @@
-#define MAXX 2033
-#define MAXY 1332
 #define VERTSCROLLDELTA 16
 #define HORIZSCROLLDELTA 16
 
@@ -13,6 +11,7 @@
 #include <xf86.h>
 #include <math.h>
 #include <stdio.h>
+#include <strings.h>
 #include <xf86_OSproc.h>
 #include <xf86Xinput.h>
 #include <exevents.h>
@@ -78,11 +77,16 @@ static int DeviceOn(DeviceIntPtr);
 static int DeviceOff(DeviceIntPtr);
 static int DeviceClose(DeviceIntPtr);
 static Bool QueryHardware(InputInfoPtr);
+static Bool SynapticsAllocSlots(SynapticsPrivate * priv);
+static void SynapticsFreeConfigs(SynapticsPrivate * priv);
+static void SynapticsPinConfig(SynapticsPrivate * priv);
+static void SynapticsUnpinConfig(SynapticsPrivate * priv);
 static void ReadDevDimensions(InputInfoPtr);
 static void SanitizeDimensions(InputInfoPtr pInfo);
 
 void InitDeviceProperties(InputInfoPtr pInfo);
 int SetProperty(DeviceIntPtr dev, Atom property, XIPropertyValuePtr prop, BOOL checkonly);
+int GetProperty(DeviceIntPtr dev, Atom property);
 
 const static struct
 {
@@ -149,7 +153,40 @@ static inline void SynapticsCloseFd(InputInfoPtr pInfo)
  */
 static void SanitizeDimensions(InputInfoPtr pInfo)
 {
+	SynapticsPrivate *priv=(SynapticsPrivate *) pInfo->private;
+
+	/* the pad this driver was first written for */
+	if(priv->minx>=priv->maxx)
+	{
+		priv->minx=0;
+		priv->maxx=2033;
+
+		xf86IDrvMsg(pInfo, X_PROBED, "invalid x-axis range.  defaulting to %d - %d\n", priv->minx, priv->maxx);
+	}
+
+	if(priv->miny>=priv->maxy)
+	{
+		priv->miny=0;
+		priv->maxy=1332;
+
+		xf86IDrvMsg(pInfo, X_PROBED, "invalid y-axis range.  defaulting to %d - %d\n", priv->miny, priv->maxy);
+	}
+
+	if(priv->minp>=priv->maxp)
+	{
+		priv->minp=0;
+		priv->maxp=255;
+
+		xf86IDrvMsg(pInfo, X_PROBED, "invalid pressure range.  defaulting to %d - %d\n", priv->minp, priv->maxp);
+	}
+
+	if(priv->minw>=priv->maxw)
+	{
+		priv->minw=0;
+		priv->maxw=15;
 
+		xf86IDrvMsg(pInfo, X_PROBED, "invalid finger width range.  defaulting to %d - %d\n", priv->minw, priv->maxw);
+	}
 }
 
 static Bool SetDeviceAndProtocol(InputInfoPtr pInfo)
@@ -243,6 +280,8 @@ static void set_default_parameters(InputInfoPtr pInfo)
 	 * sides.
 	 */
 
+	width=abs(priv->maxx-priv->minx);
+	height=abs(priv->maxy-priv->miny);
 	diag=sqrt(width*width+height*height);
 
 	/* Again, based on typical x/y range and defaults */
@@ -251,6 +290,16 @@ static void set_default_parameters(InputInfoPtr pInfo)
 	tapMove=diag*.044;
 	accelFactor=200.0/diag; /* trial-and-error */
 
+	/* scaled from pressure 200 of 256 and width 10 of 16 on the pads
+	 the palm detection was tuned on */
+	range=priv->maxp-priv->minp+1;
+	palmMinZ=priv->minp+range*(200.0/256);
+	range=priv->maxw-priv->minw+1;
+	palmMinWidth=priv->minw+range*(10.0/16);
+	range=priv->maxp-priv->minp+1;
+	pressureMotionMinZ=priv->minp+range*(30.0/256);
+	pressureMotionMaxZ=priv->minp+range*(160.0/256);
+
 	/* hysteresis, assume >= 0 is a detected value (e.g. evdev fuzz) */
 	horizHyst=pars->hyst_x>=0 ? pars->hyst_x : diag*0.005;
 	vertHyst=pars->hyst_y>=0 ? pars->hyst_y : diag*0.005;
@@ -276,6 +325,16 @@ static void set_default_parameters(InputInfoPtr pInfo)
 	pars->hyst_x=set_percent_option(opts, "HorizHysteresis", width, 0, horizHyst);
 	pars->hyst_y=set_percent_option(opts, "VertHysteresis", height, 0, vertHyst);
 
+	/* Region layout. The defaults reproduce the layout tuned on a 2033x1332
+	 pad, scaled to this one. */
+	pars->vertscroll_width=set_percent_option(opts, "VertScrollWidth", width, 0, width*100/2033);
+	pars->horizscroll_height=set_percent_option(opts, "HorizScrollHeight", height, 0, height*100/1332);
+	pars->buttons_top=set_percent_option(opts, "ButtonAreaTop", height, priv->miny, priv->miny+height*3/4+1);
+	pars->middlebtn_top=set_percent_option(opts, "MiddleButtonAreaTop", height, priv->miny, priv->miny+(height*7+9)/10);
+	pars->middlebtn_bottom=set_percent_option(opts, "MiddleButtonAreaBottom", height, priv->miny, priv->miny+height*85/100);
+	pars->middlebtn_width=set_percent_option(opts, "MiddleButtonAreaWidth", width, 0, width*200/2033);
+	pars->modifier_radius=set_percent_option(opts, "ModifierRadius", width, 0, width*200/2033);
+
 	pars->finger_low=xf86SetIntOption(opts, "FingerLow", fingerLow);
 	pars->finger_high=xf86SetIntOption(opts, "FingerHigh", fingerHigh);
 	pars->tap_time=xf86SetIntOption(opts, "MaxTapTime", 180);
@@ -315,8 +374,8 @@ static void set_default_parameters(InputInfoPtr pInfo)
 	pars->press_motion_min_z=xf86SetIntOption(opts, "PressureMotionMinZ", pressureMotionMinZ);
 	pars->press_motion_max_z=xf86SetIntOption(opts, "PressureMotionMaxZ", pressureMotionMaxZ);
 
-	pars->min_speed=xf86SetRealOption(opts, "MinSpeed", 0.4);
-	pars->max_speed=xf86SetRealOption(opts, "MaxSpeed", 0.7);
+	pars->min_speed=xf86SetRealOption(opts, "MinSpeed", 0.5);
+	pars->max_speed=xf86SetRealOption(opts, "MaxSpeed", 2.5);
 	pars->accl=xf86SetRealOption(opts, "AccelFactor", accelFactor);
 	pars->scroll_dist_circ=xf86SetRealOption(opts, "CircScrollDelta", 0.1);
 	pars->coasting_speed=xf86SetRealOption(opts, "CoastingSpeed", 20.0);
@@ -335,6 +394,9 @@ static void set_default_parameters(InputInfoPtr pInfo)
 
 	pars->tap_and_drag_gesture=xf86SetBoolOption(opts, "TapAndDragGesture",
 	TRUE);
+	pars->latency_trace=xf86SetBoolOption(opts, "LatencyTrace", FALSE);
+	pars->predict_horizon=xf86SetIntOption(opts, "PredictionHorizon", 0);
+	pars->predict_horizon=MAX(0, MIN(pars->predict_horizon, SYN_MAX_PREDICT_HORIZON));
 	pars->resolution_horiz=xf86SetIntOption(opts, "HorizResolution", horizResolution);
 	pars->resolution_vert=xf86SetIntOption(opts, "VertResolution", vertResolution);
 	if(pars->resolution_horiz<=0)
@@ -450,37 +512,112 @@ Bool SynapticsIsSoftButtonAreasValid(int *values)
 	return TRUE;
 }
 
-//TODO Dzikie węże
+/* Gain of the curve at a velocity; NaN ends up at the first point */
+static inline double accelCurveGain(const SynapticsAccelCurveRec *curve, double velocity)
+{
+	const SynapticsAccelPointRec *p=curve->points;
+	int i;
+
+	if(!(velocity>p[0].velocity))
+		return p[0].gain;
+	for(i=1; i<curve->npoints&&velocity>p[i].velocity; i++)
+		;
+	return p[i-1].gain+(velocity-p[i-1].velocity)*p[i-1].slope;
+}
+
+/*
+ * AccelFactor and the speed limits have always been tuned for velocities in
+ * units per 12.5 ms, which is what dix reported with its 80 Hz correction.
+ */
+#define ACCEL_VELOCITY_UNIT_MS 12.5
+
+/*
+ * dix's velocity is ignored: it is based on when events are posted, not
+ * when the pad sampled them, so HandleState estimates its own from the
+ * kernel timestamps right before posting.
+ */
 static double SynapticsAccelerationProfile(DeviceIntPtr dev, DeviceVelocityPtr vel, double velocity, double thr, double acc)
 {
 	InputInfoPtr pInfo=dev->public.devicePrivate;
 	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
-	SynapticsParameters *para=&priv->synpara;
 
-	double accelfct;
-
-	/*
-	 * synaptics accel was originally base on device coordinate based
-	 * velocity, which we recover this way so para->accl retains its scale.
-	 */
-	velocity/=vel->const_acceleration;
+	return accelCurveGain(priv->cfg->accel, priv->velocity*ACCEL_VELOCITY_UNIT_MS);
+}
 
-	/* speed up linear with finger velocity */
-	para->accl=0.082;
-	accelfct=velocity*para->accl;
+/*
+ * Build the acceleration curve from the parameters: through the user's
+ * points if there are any, otherwise the gain grows by AccelFactor per
+ * unit of velocity, clipped to MinSpeed and MaxSpeed.
+ */
+static SynapticsAccelCurveRec *SynapticsBuildAccel(const SynapticsParameters * para)
+{
+	SynapticsAccelCurveRec *curve;
+	SynapticsAccelPointRec *p;
+	int i;
 
-	/* clip acceleration factor */
-	if(accelfct>2.5)
-		accelfct=2.5;
-	else if(accelfct<0.5)
-		accelfct=0.5;
-//		xf86DrvMsg(pInfo, X_PROBED, "XDD %f\n",acc);
+	curve=calloc(1, sizeof(*curve));
+	if(!curve)
+		return NULL;
 
-		if(accelfct!=accelfct)
+	p=curve->points;
+	if(para->accel_npoints>0)
+	{
+		for(i=0; i<para->accel_npoints; i++)
 		{
-			xf86DrvMsg(pInfo, X_PROBED, "HUJ\nKURWA\nJEBAĆ\nPOLICJE\n",accelfct);
+			p[i].velocity=para->accel_points[i][0];
+			p[i].gain=para->accel_points[i][1];
 		}
-	return accelfct;
+		curve->npoints=para->accel_npoints;
+	}
+	else if(para->accl>0&&para->max_speed>para->min_speed)
+	{
+		p[0].velocity=para->min_speed/para->accl;
+		p[0].gain=para->min_speed;
+		p[1].velocity=para->max_speed/para->accl;
+		p[1].gain=para->max_speed;
+		curve->npoints=2;
+	}
+	else
+	{
+		p[0].gain=para->min_speed;
+		curve->npoints=1;
+	}
+	/* the last point's slope stays 0, keeping the gain flat after it */
+	for(i=0; i<curve->npoints-1; i++)
+		p[i].slope=(p[i+1].gain-p[i].gain)/(p[i+1].velocity-p[i].velocity);
+	return curve;
+}
+
+/*
+ * Build the pressure gain table: PressureMotionMinFactor up to
+ * PressureMotionMinZ, PressureMotionMaxFactor from PressureMotionMaxZ on,
+ * linear in between.
+ */
+static SynapticsPressureGainRec *SynapticsBuildPressureGain(const SynapticsPrivate * priv, const SynapticsParameters * para)
+{
+	SynapticsPressureGainRec *table;
+	int n=priv->maxp-priv->minp+1;
+	int i;
+
+	table=malloc(sizeof(*table)+n*sizeof(float));
+	if(!table)
+		return NULL;
+
+	table->minp=priv->minp;
+	table->size=n;
+	for(i=0; i<n; i++)
+	{
+		int z=priv->minp+i;
+
+		if(z<=para->press_motion_min_z)
+			table->gain[i]=para->press_motion_min_factor;
+		else if(z>=para->press_motion_max_z)
+			table->gain[i]=para->press_motion_max_factor;
+		else
+			table->gain[i]=para->press_motion_min_factor+(para->press_motion_max_factor-para->press_motion_min_factor)*
+					(z-para->press_motion_min_z)/(para->press_motion_max_z-para->press_motion_min_z);
+	}
+	return table;
 }
 
 static int SynapticsPreInit(InputDriverPtr drv, InputInfoPtr pInfo, int flags)
@@ -530,6 +667,7 @@ static int SynapticsPreInit(InputDriverPtr drv, InputInfoPtr pInfo, int flags)
 	priv->tap_button=0;
 	priv->synpara.hyst_x=-1;
 	priv->synpara.hyst_y=-1;
+	priv->num_slots=SYNAPTICS_MAX_TOUCHES;  /* until the device tells us */
 
 	/* read hardware dimensions */
 	ReadDevDimensions(pInfo);
@@ -637,6 +775,13 @@ static int DeviceOn(DeviceIntPtr dev)
 	if(priv->proto_ops->DeviceOnHook&&!priv->proto_ops->DeviceOnHook(pInfo, &priv->synpara))
 		goto error;
 
+	/* the hook may have found a different number of slots */
+	if(!SynapticsAllocSlots(priv))
+	{
+		xf86IDrvMsg(pInfo, X_ERROR, "failed to allocate touch state\n");
+		goto error;
+	}
+
 	priv->comm.buffer=XisbNew(pInfo->fd, INPUT_BUFFER_SIZE);
 	if(!priv->comm.buffer)
 		goto error;
@@ -661,16 +806,90 @@ static int DeviceOn(DeviceIntPtr dev)
 	return !Success;
 }
 
-static void SynapticsReset(SynapticsPrivate * priv)
+static void SynapticsFreeSlots(SynapticsPrivate * priv)
 {
-	int i;
+	SynapticsHwStateFree(&priv->hwState);
+	SynapticsHwStateFree(&priv->local_hw_state);
+	SynapticsHwStateFree(&priv->comm.hwState);
+	free(priv->moveHist);
+	priv->moveHist= NULL;
+	priv->predX= NULL;
+	priv->predY= NULL;
+	priv->fingerModes= NULL;
+	priv->lastRegion= NULL;
+	priv->lastX= NULL;
+	priv->lastY= NULL;
+	priv->downX= NULL;
+	priv->downY= NULL;
+	priv->downTime= NULL;
+}
+
+/*
+ * (Re)allocate everything that is sized by the number of touch slots: the
+ * three hw states and the per-slot finger modes and last positions, the
+ * latter as one block. Nothing is done if the slot count didn't change.
+ */
+static Bool SynapticsAllocSlots(SynapticsPrivate * priv)
+{
+	int n=priv->num_slots;
+
+	if(priv->hwState&&priv->hwState->num_slots==n)
+		return TRUE;
+
+	SynapticsFreeSlots(priv);
+
+	priv->hwState=SynapticsHwStateAlloc(priv);
+	priv->local_hw_state=SynapticsHwStateAlloc(priv);
+	priv->comm.hwState=SynapticsHwStateAlloc(priv);
+	priv->moveHist=calloc(n, sizeof(SynapticsMoveRingRec)+2*sizeof(double)+sizeof(enum FingerMode)+sizeof(enum SynapticsRegion)+4*sizeof(int)+sizeof(CARD32));
+	if(!priv->hwState||!priv->local_hw_state||!priv->comm.hwState||!priv->moveHist)
+	{
+		SynapticsFreeSlots(priv);
+		return FALSE;
+	}
+	priv->predX=(double *) (priv->moveHist+n);
+	priv->predY=priv->predX+n;
+	priv->fingerModes=(enum FingerMode *) (priv->predY+n);
+	priv->lastRegion=(enum SynapticsRegion *) (priv->fingerModes+n);
+	priv->lastX=(int *) (priv->lastRegion+n);
+	priv->lastY=priv->lastX+n;
+	priv->downX=priv->lastY+n;
+	priv->downY=priv->downX+n;
+	priv->downTime=(CARD32 *) (priv->downY+n);
+	memset(priv->modeSlots, 0, sizeof(priv->modeSlots));
+	priv->modeSlots[FM_NULL]=(1U<<n)-1;
+	priv->touchSlots=0;
+	priv->predictSlots=0;
+	priv->palmSlots=0;
 
 	SynapticsResetHwState(priv->hwState);
 	SynapticsResetHwState(priv->local_hw_state);
 	SynapticsResetHwState(priv->comm.hwState);
+	return TRUE;
+}
+
+static void SynapticsReset(SynapticsPrivate * priv)
+{
+	int i;
+
+	if(priv->hwState)
+	{
+		SynapticsResetHwState(priv->hwState);
+		SynapticsResetHwState(priv->local_hw_state);
+		SynapticsResetHwState(priv->comm.hwState);
+		memset(priv->predX, 0, 2*priv->hwState->num_slots*sizeof(double));
+	}
+	/* the positions are gone, so nothing in lastX/lastY can be trusted */
+	priv->staleSlots=~0U;
+	priv->touchSlots=0;
+	priv->predictSlots=0;
+	priv->palmSlots=0;
+	/* a coast interrupted by DeviceOff doesn't resume */
+	priv->coastSpeedH=priv->coastSpeedV=0;
 
 	priv->count_packet_finger=0;
 	priv->last_motion_millis=0;
+	priv->tap_state=TS_START;
 	priv->tap_button=0;
 }
 
@@ -685,6 +904,7 @@ static int DeviceOff(DeviceIntPtr dev)
 	if(pInfo->fd!=-1)
 	{
 		TimerCancel(priv->timer);
+		priv->timer_armed= FALSE;
 		xf86RemoveEnabledDevice(pInfo);
 		SynapticsReset(priv);
 
@@ -710,9 +930,8 @@ static int DeviceClose(DeviceIntPtr dev)
 	RetValue=DeviceOff(dev);
 	TimerFree(priv->timer);
 	priv->timer= NULL;
-	SynapticsHwStateFree(&priv->hwState);
-	SynapticsHwStateFree(&priv->local_hw_state);
-	SynapticsHwStateFree(&priv->comm.hwState);
+	SynapticsFreeSlots(priv);
+	SynapticsFreeConfigs(priv);
 	return RetValue;
 }
 
@@ -843,12 +1062,11 @@ static int DeviceInit(DeviceIntPtr dev)
 //                    priv->synpara.accl);
 	pVel = GetDevicePredictableAccelData(dev);
 	SetDeviceSpecificAccelerationProfile(pVel, SynapticsAccelerationProfile);
-    /* synaptics seems to report 80 packet/s, but dix scales for
-     * 100 packet/s by default. */
-    pVel->corr_mul = 12.5f; /*1000[ms]/80[/s] = 12.5 */
-	SetScrollValuator(dev, 2, SCROLL_TYPE_HORIZONTAL,
+	priv->scroll_axis_horiz=2;
+	priv->scroll_axis_vert=3;
+	SetScrollValuator(dev, priv->scroll_axis_horiz, SCROLL_TYPE_HORIZONTAL,
 	HORIZSCROLLDELTA, 0);
-	SetScrollValuator(dev, 3, SCROLL_TYPE_VERTICAL,
+	SetScrollValuator(dev, priv->scroll_axis_vert, SCROLL_TYPE_VERTICAL,
 	VERTSCROLLDELTA, 0);
 	prop=XIGetKnownProperty(ACCEL_PROP_PROFILE_NUMBER);
 	i= AccelProfileDeviceSpecific;
@@ -857,33 +1075,63 @@ static int DeviceInit(DeviceIntPtr dev)
 
 	free(axes_labels);
 
-	priv->hwState=SynapticsHwStateAlloc(priv);
-	if(!priv->hwState)
-		goto fail;
-
-	priv->local_hw_state=SynapticsHwStateAlloc(priv);
-	if(!priv->local_hw_state)
-		goto fail;
+	if(!priv->scroll_events_mask)
+		priv->scroll_events_mask=valuator_mask_new(num_axes);
+	if(!priv->scroll_events_mask)
+	{
+		xf86IDrvMsg(pInfo, X_ERROR, "failed to allocate scroll valuator mask\n");
+		return !Success;
+	}
 
-	priv->comm.hwState=SynapticsHwStateAlloc(priv);
+	if(!SynapticsPublishConfig(priv, SYN_DERIVED_ALL))
+	{
+		xf86IDrvMsg(pInfo, X_ERROR, "failed to allocate configuration\n");
+		return !Success;
+	}
 
+	/* the per-slot state is allocated in DeviceOn, once the number of
+	 slots is known */
 	InitDeviceProperties(pInfo);
-	XIRegisterPropertyHandler(pInfo->dev, SetProperty, NULL, NULL);
+	XIRegisterPropertyHandler(pInfo->dev, SetProperty, GetProperty, NULL);
 
 	SynapticsReset(priv);
 
 	return Success;
+}
 
-	fail: free(priv->local_hw_state);
-	free(priv->hwState);
-	return !Success;
+static CARD32 timerFunc(OsTimerPtr timer, CARD32 now, pointer arg);
+
+/*
+ * Have the timer fire delay ms from now, or not at all if delay is 0.
+ * The server's timer list is only touched when that changes anything: a
+ * timer already due earlier is left alone, firing early only gives
+ * HandleState an extra look at the state.
+ */
+static void SynapticsScheduleTimer(InputInfoPtr pInfo, CARD32 now, int delay)
+{
+	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
+	CARD32 deadline=now+delay;
+
+	if(delay<=0)
+	{
+		if(priv->timer_armed)
+			TimerCancel(priv->timer);
+		priv->timer_armed= FALSE;
+		return;
+	}
+	if(priv->timer_armed&&(int)(priv->timer_deadline-deadline)<=0)
+		return;
+
+	priv->timer=TimerSet(priv->timer, 0, delay, timerFunc, pInfo);
+	priv->timer_deadline=deadline;
+	priv->timer_armed= TRUE;
 }
 
 static CARD32 timerFunc(OsTimerPtr timer, CARD32 now, pointer arg)
 {
 	InputInfoPtr pInfo=arg;
 	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
-	struct SynapticsHwState *hw=priv->local_hw_state;
+	struct SynapticsHwState *hw=priv->hwState;
 	int delay;
 #if !HAVE_THREADED_INPUT
 	int sigstate = xf86BlockSIGIO();
@@ -891,14 +1139,18 @@ static CARD32 timerFunc(OsTimerPtr timer, CARD32 now, pointer arg)
 	input_lock();
 #endif
 
-	priv->hwState->millis+=now-priv->timer_time;
-	SynapticsCopyHwState(hw, priv->hwState);
+	/* the last report's state, with no slot marked as changed */
+	priv->timer_armed= FALSE;
+	hw->millis+=now-priv->timer_time;
+	hw->usec+=(CARD64) (now-priv->timer_time)*1000;
 	//TODO DYS
 //    SynapticsResetTouchHwState(hw, FALSE);
+	SynapticsPinConfig(priv);
 	delay=HandleState(pInfo, hw, hw->millis, TRUE);
+	SynapticsUnpinConfig(priv);
 
 	priv->timer_time=now;
-	priv->timer=TimerSet(priv->timer, 0, delay, timerFunc, pInfo);
+	SynapticsScheduleTimer(pInfo, now, delay);
 
 #if !HAVE_THREADED_INPUT
 	xf86UnblockSIGIO(sigstate);
@@ -909,6 +1161,87 @@ static CARD32 timerFunc(OsTimerPtr timer, CARD32 now, pointer arg)
 	return 0;
 }
 
+/*
+ * Record the latency of one report. Runs in the input thread, which is the
+ * only writer of samples and head.
+ */
+static void SynapticsLatencyRecord(SynapticsLatencyRec *lat, CARD64 kernel, CARD64 read, CARD64 posted)
+{
+	unsigned int head=atomic_load_explicit(&lat->head, memory_order_relaxed);
+	SynapticsLatencySampleRec *sample=&lat->samples[head&(SYN_LATENCY_SAMPLES-1)];
+
+	/* kernel timestamps are CLOCK_MONOTONIC like the server's, but guard
+	 against clock mismatch anyway */
+	sample->read=read>kernel ? read-kernel : 0;
+	sample->post=posted>read ? posted-read : 0;
+	atomic_store_explicit(&lat->head, head+1, memory_order_release);
+}
+
+void SynapticsLatencyReset(SynapticsLatencyRec *lat)
+{
+	atomic_store_explicit(&lat->reset, atomic_load_explicit(&lat->head, memory_order_acquire), memory_order_relaxed);
+}
+
+static int cmpCard32(const void *a, const void *b)
+{
+	CARD32 x=*(const CARD32 *) a, y=*(const CARD32 *) b;
+
+	return x<y ? -1 : x>y;
+}
+
+static void percentiles(CARD32 *values, unsigned int n, CARD32 *stats)
+{
+	if(n==0)
+	{
+		stats[0]=stats[1]=stats[2]=0;
+		return;
+	}
+	qsort(values, n, sizeof(CARD32), cmpCard32);
+	stats[0]=values[n/2];
+	stats[1]=values[(n*99)/100];
+	stats[2]=values[n-1];
+}
+
+/*
+ * Compute p50, p99 and max of the kernel->driver, driver->post and total
+ * latency over the samples recorded since the last reset. Called from the
+ * main thread; samples the input thread may have overwritten while they
+ * were being copied are discarded instead of locking it out.
+ */
+void SynapticsLatencyStats(SynapticsLatencyRec *lat, CARD32 stats[SYN_LATENCY_NSTATS])
+{
+	CARD32 read[SYN_LATENCY_SAMPLES], post[SYN_LATENCY_SAMPLES], total[SYN_LATENCY_SAMPLES];
+	unsigned int head=atomic_load_explicit(&lat->head, memory_order_acquire);
+	unsigned int start=atomic_load_explicit(&lat->reset, memory_order_relaxed);
+	unsigned int first, last, i, n;
+
+	if(head-start>SYN_LATENCY_SAMPLES)
+		start=head-SYN_LATENCY_SAMPLES;
+	for(i=start; i!=head; i++)
+	{
+		const SynapticsLatencySampleRec *sample=&lat->samples[i&(SYN_LATENCY_SAMPLES-1)];
+
+		read[i-start]=sample->read;
+		post[i-start]=sample->post;
+	}
+
+	/* drop whatever was overwritten while copying, and the slot of sample
+	 last, which the writer may be halfway through */
+	last=atomic_load_explicit(&lat->head, memory_order_acquire);
+	first=start;
+	if(last+1-first>SYN_LATENCY_SAMPLES)
+		first=last+1-SYN_LATENCY_SAMPLES;
+	if((int)(head-first)<0)
+		first=head;
+	n=head-first;
+
+	for(i=0; i<n; i++)
+		total[i]=read[first-start+i]+post[first-start+i];
+	percentiles(read+(first-start), n, stats);
+	percentiles(post+(first-start), n, stats+3);
+	percentiles(total, n, stats+6);
+}
+
 static Bool SynapticsGetHwState(InputInfoPtr pInfo, SynapticsPrivate * priv, struct SynapticsHwState *hw)
 {
 	return priv->proto_ops->ReadHwState(pInfo, &priv->comm, hw);
@@ -932,14 +1265,25 @@ static void ReadInput(InputInfoPtr pInfo)
 			hw->millis=priv->hwState->millis;
 
 		SynapticsCopyHwState(priv->hwState, hw);
-		delay=HandleState(pInfo, hw, hw->millis, FALSE);
+		priv->hwState->dirty=0;
+		SynapticsPinConfig(priv);
+		if(priv->cfg->para.latency_trace)
+		{
+			CARD64 read=GetTimeInMicros();
+
+			delay=HandleState(pInfo, hw, hw->millis, FALSE);
+			SynapticsLatencyRecord(&priv->latency, hw->usec, read, GetTimeInMicros());
+		}
+		else
+			delay=HandleState(pInfo, hw, hw->millis, FALSE);
+		SynapticsUnpinConfig(priv);
 		newDelay= TRUE;
 	}
 
 	if(newDelay)
 	{
 		priv->timer_time=GetTimeInMillis();
-		priv->timer=TimerSet(priv->timer, 0, delay, timerFunc, pInfo);
+		SynapticsScheduleTimer(pInfo, priv->timer_time, delay);
 	}
 }
 
@@ -953,165 +1297,803 @@ static void ReadInput(InputInfoPtr pInfo)
  * generate fake motion events, or for the tap-to-click state machine), rather
  * than from having received a motion event.
  */
-#define BUTTONS_Y MAXY*0.75
-#define MIDDLEBTN_TOP MAXY*0.7
-#define MIDDLEBTN_BOTTOM MAXY*0.85
-#define MIDDLEBTN_RADIUS 100
-#define VERTSCROLL_WIDTH 100
-#define HORIZSCROLL_WIDTH 100
-#define MODIFIER_RADIUS 200
+/* Exact classification, used to build the grid and for boundary cells */
+static enum SynapticsRegion classifyRegion(const SynapticsRegionMapRec * map, int x, int y)
+{
+	int i;
+
+	if(x<map->minx||y<map->miny)
+		return RG_NULL;
+
+	for(i=0; i<map->nareas; i++)
+	{
+		const SynapticsRegionAreaRec *area=&map->areas[i];
+
+		if(area->r>0)
+		{
+			if(SQR(x-area->x0)+SQR(y-area->y0)<SQR(area->r))
+				return area->region;
+		}
+		else if(x>=area->x0&&x<=area->x1&&y>=area->y0&&y<=area->y1)
+			return area->region;
+	}
+	return RG_MOVE;
+}
 
-static enum SynapticsRegion getRegionAt(int x, int y)
+/* Does the edge between v-1 and v, or v and v+1, lie inside [lo, hi]? */
+#define SPLITS_BEFORE(v, lo, hi) ((v)>(lo)&&(v)<=(hi))
+#define SPLITS_AFTER(v, lo, hi) ((v)>=(lo)&&(v)<(hi))
+
+/*
+ * A cell is uniform if no area edge runs through it and it lies entirely
+ * inside or outside every circle, judged by its nearest and farthest points
+ * from the centre.
+ */
+static Bool regionCellUniform(const SynapticsRegionMapRec * map, int x0, int y0, int x1, int y1)
 {
-	if(x<0||y<0)
+	int i;
+
+	if(SPLITS_BEFORE(map->minx, x0, x1)||SPLITS_BEFORE(map->miny, y0, y1))
+		return FALSE;
+
+	for(i=0; i<map->nareas; i++)
 	{
-		return RG_NULL;
+		const SynapticsRegionAreaRec *area=&map->areas[i];
+
+		if(area->r>0)
+		{
+			double nx=MAX(MAX(x0-area->x0, area->x0-x1), 0);
+			double ny=MAX(MAX(y0-area->y0, area->y0-y1), 0);
+			double fx=MAX(abs(x0-area->x0), abs(x1-area->x0));
+			double fy=MAX(abs(y0-area->y0), abs(y1-area->y0));
+
+			if(SQR(nx)+SQR(ny)<SQR(area->r)&&SQR(fx)+SQR(fy)>=SQR(area->r))
+				return FALSE;
+		}
+		else if(SPLITS_BEFORE(area->x0, x0, x1)||SPLITS_AFTER(area->x1, x0, x1)||
+		        SPLITS_BEFORE(area->y0, y0, y1)||SPLITS_AFTER(area->y1, y0, y1))
+			return FALSE;
 	}
-	//if((x>MAXX-VERTSCROLL_WIDTH||x<VERTSCROLL_WIDTH)&&y<HORIZSCROLL_WIDTH)
-	if(SQR(x)+SQR(y)<SQR(MODIFIER_RADIUS))
+	return TRUE;
+}
+
+static void addRegionArea(SynapticsRegionMapRec * map, enum SynapticsRegion region, int x0, int y0, int x1, int y1, int r)
+{
+	SynapticsRegionAreaRec *area=&map->areas[map->nareas++];
+
+	area->region=region;
+	area->x0=x0;
+	area->y0=y0;
+	area->x1=x1;
+	area->y1=y1;
+	area->r=r;
+}
+
+/*
+ * Turn the region parameters and the pad dimensions into the area table
+ * and the grid. Areas are checked in order:
+ * the modifier circle around the top-left corner, the right edge vertical
+ * scroll strip, the top edge horizontal scroll strip, the centred middle
+ * button and the left/right halves of the button row.
+ */
+static SynapticsRegionMapRec *SynapticsBuildRegions(const SynapticsPrivate * priv, const SynapticsParameters * para)
+{
+	SynapticsRegionMapRec *map;
+	int width=priv->maxx-priv->minx;
+	int height=priv->maxy-priv->miny;
+	int center=priv->minx+width/2;
+	unsigned int shift=0;
+	unsigned int cols, rows, cx, cy;
+
+	/* keep the grid within 64x64 cells whatever the pad's units */
+	while((MAX(width, height)>>shift)>=64)
+		shift++;
+	cols=(width>>shift)+1;
+	rows=(height>>shift)+1;
+
+	map=calloc(1, sizeof(*map)+cols*rows);
+	if(!map)
+		return NULL;
+
+	map->minx=priv->minx;
+	map->miny=priv->miny;
+	if(para->modifier_radius>0)
+		addRegionArea(map, RG_MODIFIER, priv->minx, priv->miny, 0, 0, para->modifier_radius);
+	if(para->vertscroll_width>0)
+		addRegionArea(map, RG_VERTSCROLL, priv->maxx-para->vertscroll_width+1, priv->miny, INT_MAX, INT_MAX, 0);
+	if(para->horizscroll_height>0)
+		addRegionArea(map, RG_HORIZSCROLL, priv->minx, priv->miny, INT_MAX, priv->miny+para->horizscroll_height-1, 0);
+	if(para->middlebtn_width>0)
+		addRegionArea(map, RG_MIDDLEBTN, center-para->middlebtn_width/2+1, para->middlebtn_top, center+para->middlebtn_width/2,
+		        para->middlebtn_bottom, 0);
+	addRegionArea(map, RG_LEFTBTN, priv->minx, para->buttons_top, center, INT_MAX, 0);
+	addRegionArea(map, RG_RIGHTBTN, center+1, para->buttons_top, INT_MAX, INT_MAX, 0);
+
+	map->shift=shift;
+	map->cols=cols;
+	map->rows=rows;
+	for(cy=0; cy<rows; cy++)
+		for(cx=0; cx<cols; cx++)
+		{
+			int x0=priv->minx+(cx<<shift), y0=priv->miny+(cy<<shift);
+			int x1=x0+(1<<shift)-1, y1=y0+(1<<shift)-1;
+
+			map->cells[cy*cols+cx]=regionCellUniform(map, x0, y0, x1, y1) ?
+			        classifyRegion(map, x0, y0) : SYN_REGION_BOUNDARY;
+		}
+	return map;
+}
+
+static Bool SynapticsConfigUses(const SynapticsConfigRec * cfg, const void *table)
+{
+	return cfg->regions==table||cfg->accel==table||cfg->pressureGain==table;
+}
+
+/* Whether a config other than cfg, published or retired, shares the table */
+static Bool SynapticsTableShared(SynapticsPrivate * priv, const SynapticsConfigRec * cfg, const void *table)
+{
+	const SynapticsConfigRec *other=atomic_load_explicit(&priv->config, memory_order_relaxed);
+
+	if(other&&other!=cfg&&SynapticsConfigUses(other, table))
+		return TRUE;
+	for(other=priv->config_retired; other; other=other->next)
+		if(other!=cfg&&SynapticsConfigUses(other, table))
+			return TRUE;
+	return FALSE;
+}
+
+/* Free a config that is neither published nor retired, and the tables only it uses */
+static void SynapticsConfigFree(SynapticsPrivate * priv, SynapticsConfigRec * cfg)
+{
+	if(!SynapticsTableShared(priv, cfg, cfg->regions))
+		free(cfg->regions);
+	if(!SynapticsTableShared(priv, cfg, cfg->accel))
+		free(cfg->accel);
+	if(!SynapticsTableShared(priv, cfg, cfg->pressureGain))
+		free(cfg->pressureGain);
+	free(cfg);
+}
+
+/* Free the retired configs that the input thread isn't reading */
+static void SynapticsReclaimConfigs(SynapticsPrivate * priv)
+{
+	SynapticsConfigRec *pinned=atomic_load(&priv->config_pinned);
+	SynapticsConfigRec **p=&priv->config_retired;
+
+	while(*p)
 	{
-		return RG_MODIFIER;
+		SynapticsConfigRec *cfg=*p;
+
+		if(cfg==pinned)
+			p=&cfg->next;
+		else
+		{
+			*p=cfg->next;
+			SynapticsConfigFree(priv, cfg);
+		}
 	}
-	if(x>MAXX-VERTSCROLL_WIDTH)
+}
+
+/*
+ * Snapshot the parameters, rebuild the derived tables in rebuild (all of
+ * them the first time) and publish the result to the input thread with
+ * one pointer store. The other tables are shared with the config being
+ * replaced. Called from the main thread whenever a parameter changes. The
+ * config replaced is freed as soon as the input thread isn't pinning it,
+ * here or on a later call.
+ */
+Bool SynapticsPublishConfig(SynapticsPrivate * priv, unsigned int rebuild)
+{
+	SynapticsConfigRec *cfg, *old;
+
+	/* the main thread is the only writer */
+	old=atomic_load_explicit(&priv->config, memory_order_relaxed);
+	if(!old)
+		rebuild=SYN_DERIVED_ALL;
+
+	cfg=calloc(1, sizeof(*cfg));
+	if(!cfg)
+		return FALSE;
+
+	cfg->para=priv->synpara;
+	cfg->regions=rebuild&SYN_DERIVED_REGIONS ? SynapticsBuildRegions(priv, &cfg->para) : old->regions;
+	cfg->accel=rebuild&SYN_DERIVED_ACCEL ? SynapticsBuildAccel(&cfg->para) : old->accel;
+	cfg->pressureGain=rebuild&SYN_DERIVED_PRESSURE ? SynapticsBuildPressureGain(priv, &cfg->para) : old->pressureGain;
+	if(!cfg->regions||!cfg->accel||!cfg->pressureGain)
 	{
-		return RG_VERTSCROLL;
+		SynapticsConfigFree(priv, cfg);
+		return FALSE;
 	}
-	if(y<HORIZSCROLL_WIDTH)
+
+	/* a serial rather than the pointer, the map may reuse a freed one's memory */
+	cfg->regions_serial=old ? old->regions_serial+!!(rebuild&SYN_DERIVED_REGIONS) : 1;
+	atomic_store(&priv->config, cfg);
+	if(old)
 	{
-		return RG_HORIZSCROLL;
+		old->next=priv->config_retired;
+		priv->config_retired=old;
 	}
-	if(y>=MIDDLEBTN_TOP&&y<=MIDDLEBTN_BOTTOM&&x>MAXX/2-MIDDLEBTN_RADIUS&&x<=MAXX/2+MIDDLEBTN_RADIUS)
+	SynapticsReclaimConfigs(priv);
+	return TRUE;
+}
+
+static void SynapticsFreeConfigs(SynapticsPrivate * priv)
+{
+	SynapticsConfigRec *cfg=atomic_load(&priv->config);
+
+	/* retire the published config too and drop everything */
+	atomic_store(&priv->config, NULL);
+	if(cfg)
 	{
-		return RG_MIDDLEBTN;
+		cfg->next=priv->config_retired;
+		priv->config_retired=cfg;
 	}
-	if(y>BUTTONS_Y)
+	atomic_store(&priv->config_pinned, NULL);
+	SynapticsReclaimConfigs(priv);
+}
+
+/*
+ * Pin the published config for one pass of the input thread. Once the
+ * pin is seen to be set while the config is still the published one,
+ * SynapticsReclaimConfigs won't free it until it's released.
+ */
+static void SynapticsPinConfig(SynapticsPrivate * priv)
+{
+	SynapticsConfigRec *cfg;
+
+	do
 	{
-		if(x>MAXX/2)
-		{
-			return RG_RIGHTBTN;
-		}
-		else
-		{
-			return RG_LEFTBTN;
-		}
+		cfg=atomic_load(&priv->config);
+		atomic_store(&priv->config_pinned, cfg);
+	} while(cfg!=atomic_load(&priv->config));
+	priv->cfg=cfg;
+}
+
+static void SynapticsUnpinConfig(SynapticsPrivate * priv)
+{
+	priv->cfg= NULL;
+	atomic_store(&priv->config_pinned, NULL);
+}
+
+/*
+ * Finger mode transitions, [current mode][region under the finger]. A new
+ * finger takes the mode of the region it lands in, button fingers may
+ * slide between the buttons, everything else keeps its mode until the
+ * finger lifts (RG_NULL). Looking up a mode again with the same region
+ * never changes it, so fingers whose region didn't change can be skipped.
+ */
+static const unsigned char fingerModeTransitions[FM_MODIFIER+1][RG_MODIFIER+1]=
+{
+	/*                  RG_NULL         RG_MOVE         RG_LEFTBTN      RG_RIGHTBTN     RG_MIDDLEBTN    RG_HORIZSCROLL  RG_VERTSCROLL   RG_MODIFIER */
+	[FM_NULL]=         {FM_NULL,        FM_MOVE,        FM_LEFTBTN,     FM_RIGHTBTN,    FM_MIDDLEBTN,   FM_HORIZSCROLL, FM_VERTSCROLL,  FM_MODIFIER},
+	[FM_MOVE]=         {FM_NULL,        FM_MOVE,        FM_MOVE,        FM_MOVE,        FM_MOVE,        FM_MOVE,        FM_MOVE,        FM_MOVE},
+	[FM_LEFTBTN]=      {FM_NULL,        FM_LEFTBTN,     FM_LEFTBTN,     FM_RIGHTBTN,    FM_MIDDLEBTN,   FM_LEFTBTN,     FM_LEFTBTN,     FM_LEFTBTN},
+	[FM_RIGHTBTN]=     {FM_NULL,        FM_RIGHTBTN,    FM_LEFTBTN,     FM_RIGHTBTN,    FM_MIDDLEBTN,   FM_RIGHTBTN,    FM_RIGHTBTN,    FM_RIGHTBTN},
+	[FM_MIDDLEBTN]=    {FM_NULL,        FM_MIDDLEBTN,   FM_LEFTBTN,     FM_RIGHTBTN,    FM_MIDDLEBTN,   FM_MIDDLEBTN,   FM_MIDDLEBTN,   FM_MIDDLEBTN},
+	[FM_HORIZSCROLL]=  {FM_NULL,        FM_HORIZSCROLL, FM_HORIZSCROLL, FM_HORIZSCROLL, FM_HORIZSCROLL, FM_HORIZSCROLL, FM_HORIZSCROLL, FM_HORIZSCROLL},
+	[FM_VERTSCROLL]=   {FM_NULL,        FM_VERTSCROLL,  FM_VERTSCROLL,  FM_VERTSCROLL,  FM_VERTSCROLL,  FM_VERTSCROLL,  FM_VERTSCROLL,  FM_VERTSCROLL},
+	[FM_MODIFIER]=     {FM_NULL,        FM_MODIFIER,    FM_MODIFIER,    FM_MODIFIER,    FM_MODIFIER,    FM_MODIFIER,    FM_MODIFIER,    FM_MODIFIER},
+};
+
+/* Modes that track motion from where the finger entered them */
+#define FM_ANCHORED ((1<<FM_MOVE)|(1<<FM_HORIZSCROLL)|(1<<FM_VERTSCROLL))
+
+/* Samples older than this say nothing about the current speed */
+#define MOVE_HISTORY_WINDOW_US 100000
+
+static inline void moveHistPush(SynapticsMoveRingRec *ring, int x, int y, CARD64 usec)
+{
+	SynapticsMoveHistRec *h=&ring->hist[ring->head++%SYNAPTICS_MOVE_HISTORY];
+
+	h->x=x;
+	h->y=y;
+	h->usec=usec;
+}
+
+/*
+ * Velocity of a touch in units/ms at time now, from the oldest sample in
+ * the ring that is still within the window. Time since the newest sample
+ * counts as standing still. Being based on the kernel's timestamps, it
+ * doesn't depend on the report rate or on read delays.
+ */
+static void moveHistVelocity(const SynapticsMoveRingRec *ring, CARD64 now, double *vx, double *vy)
+{
+	unsigned int n=MIN(ring->head, SYNAPTICS_MOVE_HISTORY);
+	const SynapticsMoveHistRec *first= NULL, *last;
+	double dt;
+	unsigned int i;
+
+	*vx=*vy=0;
+	if(n<2)
+		return;
+	last=&ring->hist[(ring->head-1)%SYNAPTICS_MOVE_HISTORY];
+	for(i=n; i>=2; i--)
+	{
+		first=&ring->hist[(ring->head-i)%SYNAPTICS_MOVE_HISTORY];
+		/* also skips timestamps going backwards */
+		if(now-first->usec<=MOVE_HISTORY_WINDOW_US)
+			break;
 	}
-	return RG_MOVE;
+	if(i<2||now==first->usec)
+		return;
+
+	dt=(now-first->usec)/1000.0;
+	*vx=(last->x-first->x)/dt;
+	*vy=(last->y-first->y)/dt;
 }
-static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 now, Bool from_timer)
+
+/* One load for fingers inside a uniform cell, exact test otherwise */
+static inline enum SynapticsRegion getRegionAt(const SynapticsPrivate * priv, int x, int y)
+{
+	const SynapticsRegionMapRec *map=priv->cfg->regions;
+	unsigned int cx=(unsigned int) (x-map->minx)>>map->shift;
+	unsigned int cy=(unsigned int) (y-map->miny)>>map->shift;
+
+	if(cx<map->cols&&cy<map->rows)
+	{
+		unsigned char region=map->cells[cy*map->cols+cx];
+
+		if(region!=SYN_REGION_BOUNDARY)
+			return region;
+	}
+	return classifyRegion(map, x, y);
+}
+
+/*
+ * Keep a box of +-margin around the last position and only move it as far
+ * as needed to contain the new one; returns the box's new centre.
+ */
+static inline int hysteresis(int in, int center, int margin)
+{
+	int diff=in-center;
+
+	if(abs(diff)<=margin)
+		return center;
+	return diff>0 ? in-margin : in+margin;
+}
+
+/*
+ * Whether a finger moved further than MaxDeltaMM within one report, which
+ * only happens when one finger lifts and another lands in the same slot
+ * between two reports.
+ */
+static inline Bool fingerJumped(const SynapticsParameters * para, int dx, int dy)
+{
+	double mx=(double) dx/para->resolution_horiz;
+	double my=(double) dy/para->resolution_vert;
+
+	return para->maxDeltaMM>0&&mx*mx+my*my>(double) para->maxDeltaMM*para->maxDeltaMM;
+}
+
+/* Motion gain for a finger pressing with z, unknown pressures count as the lowest */
+static inline double pressureGain(const SynapticsPrivate * priv, int z)
+{
+	const SynapticsPressureGainRec *table=priv->cfg->pressureGain;
+
+	return table->gain[MAX(0, MIN(z-table->minp, table->size-1))];
+}
+
+/* How often a prediction lead is re-evaluated without reports, in ms */
+#define PREDICT_INTERVAL 10
+
+/*
+ * Motion prediction stage: extrapolate a moving finger predict_horizon ms
+ * ahead at its current velocity. The pointer is kept ahead of the finger by
+ * the latest prediction only, so a finger slowing down or a horizon of 0
+ * takes the lead back.
+ *
+ * The lead is accounted for in posted units, after the modifier factor and
+ * the acceleration gain, which both change while the finger slows down.
+ * This adds the old lead to backX/backY and leaves the new one in predX/
+ * predY in device units; HandleState scales it once the report's factor and
+ * gain are known and posts the difference, so taking it back undoes exactly
+ * what it moved the pointer.
+ */
+static void predictMotion(SynapticsPrivate * priv, int f, double vx, double vy, double *backX, double *backY)
+{
+	double h=priv->cfg->para.predict_horizon;
+	double px=vx*h, py=vy*h;
+
+	*backX+=priv->predX[f];
+	*backY+=priv->predY[f];
+	priv->predX[f]=px;
+	priv->predY[f]=py;
+	if(px!=0||py!=0)
+		priv->predictSlots|=1U<<f;
+	else
+		priv->predictSlots&=~(1U<<f);
+}
+
+/* Coasting frames are spaced to scroll about 1/COASTING_STEPS of a scroll
+ each, within these bounds in ms */
+#define COASTING_STEPS 8
+#define COASTING_MIN_INTERVAL 10
+#define COASTING_MAX_INTERVAL 50
+
+/*
+ * Start coasting on the axes whose lift-off speed, in units/ms, is above
+ * CoastingSpeed. Speeds below it leave that axis alone.
+ */
+static void SynapticsStartCoasting(SynapticsPrivate * priv, double speedH, double speedV, CARD32 now)
+{
+	const SynapticsParameters *para=&priv->cfg->para;
+
+	if(para->coasting_speed<=0)
+		return;
+	if(fabs(speedH)*1000>=para->coasting_speed*para->scroll_dist_horiz)
+		priv->coastSpeedH=speedH;
+	if(fabs(speedV)*1000>=para->coasting_speed*para->scroll_dist_vert)
+		priv->coastSpeedV=speedV;
+	priv->coastTime=now;
+}
+
+/*
+ * Advance one coasting axis by dt ms while slowing down by decel
+ * units/ms^2, and return the distance covered. Stops at 0 rather than
+ * reversing.
+ */
+static double coastAxis(double *speed, double decel, double dt)
+{
+	double v=*speed, stop;
+
+	if(v==0)
+		return 0;
+	if(decel>0&&(stop=fabs(v)/decel)<=dt)
+	{
+		*speed=0;
+		return v*stop/2;
+	}
+	*speed=v>0 ? v-decel*dt : v+decel*dt;
+	return (v+*speed)/2*dt;
+}
+
+/*
+ * Add the scroll distance covered since coasting was last advanced and
+ * return when it should be advanced next, or 0 once it has come to a halt.
+ */
+static int SynapticsCoast(SynapticsPrivate * priv, CARD32 now, double *scH, double *scV)
+{
+	const SynapticsParameters *para=&priv->cfg->para;
+	double dt=(int)(now-priv->coastTime);
+	double rate;
+
+	if(priv->coastSpeedH==0&&priv->coastSpeedV==0)
+		return 0;
+
+	/* CoastingFriction is in scrolls/s^2 */
+	if(dt>0)
+	{
+		*scH+=coastAxis(&priv->coastSpeedH, para->coasting_friction*para->scroll_dist_horiz/1e6, dt);
+		*scV+=coastAxis(&priv->coastSpeedV, para->coasting_friction*para->scroll_dist_vert/1e6, dt);
+		priv->coastTime=now;
+	}
+
+	/* scrolls per ms on the faster axis */
+	rate=MAX(fabs(priv->coastSpeedH)/para->scroll_dist_horiz, fabs(priv->coastSpeedV)/para->scroll_dist_vert);
+	if(rate==0)
+		return 0;
+	return MIN(MAX(1/(rate*COASTING_STEPS), COASTING_MIN_INTERVAL), COASTING_MAX_INTERVAL);
+}
+
+/* The earlier of two timer delays, where 0 means no timer */
+static inline int mergeDelay(int a, int b)
+{
+	if(!a)
+		return b;
+	if(!b)
+		return a;
+	return MIN(a, b);
+}
+
+/* Button for a tap with 1, 2 or 3 fingers */
+static const int tapButtons[4]={0, 1, 3, 2};
+
+/* Start timing a tap from the touch-down of the first finger in landed */
+static void tapBegin(SynapticsPrivate * priv, enum TapState state, unsigned int landed, int timeout)
+{
+	priv->tap_state=state;
+	priv->tap_start=priv->downTime[ffs(landed)-1];
+	priv->tap_deadline=priv->tap_start+timeout;
+	priv->tap_moved= FALSE;
+	priv->tap_max_fingers=Ones(priv->touchSlots);
+}
+
+static void tapButton(InputInfoPtr pInfo, int button, Bool press)
 {
 	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
-	SynapticsParameters *para=&priv->synpara;
-	int delay=100000;
-	int timeleft;
-	double dx=0, dy=0, scH=0, scV=0;
-	Bool inside_active_area;
 
-	//Finger mode processing
-	for(int f=0; f<5; f++)
+	xf86PostButtonEvent(pInfo->dev, FALSE, button, press, 0, 0);
+	priv->tap_button=press ? button : 0;
+}
+
+/*
+ * Tap-to-click, tap-and-drag and locked drags. The touch states only look
+ * at their deadline when the fingers lift, the states waiting with no
+ * finger down return the time left until theirs, so the timer runs only
+ * while a tap is pending. landed has the fingers that touched down on
+ * this report, touchSlots the ones down now.
+ */
+static int SynapticsTap(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 now, unsigned int dirty, unsigned int landed)
+{
+	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
+	const SynapticsParameters *para=&priv->cfg->para;
+	int fingers=Ones(priv->touchSlots);
+	Bool expired=(int)(now-priv->tap_deadline)>=0;
+	Bool tapped;
+	unsigned int pending;
+
+	for(pending=dirty&priv->touchSlots; pending; pending&=pending-1)
 	{
-		enum SynapticsRegion region=getRegionAt(hw->x[f], hw->y[f]);
-		switch(priv->fingerModes[f])
-		{
-			case FM_NULL:
-					switch(region)
-					{
-						case RG_MOVE:
-							priv->fingerModes[f]=FM_MOVE;
-							priv->lastX[f]=hw->x[f];
-							priv->lastY[f]=hw->y[f];
-							break;
-						case RG_VERTSCROLL:
-							priv->fingerModes[f]=FM_VERTSCROLL;
-							priv->lastX[f]=hw->x[f];
-							priv->lastY[f]=hw->y[f];
-							break;
-						case RG_HORIZSCROLL:
-							priv->fingerModes[f]=FM_HORIZSCROLL;
-							priv->lastX[f]=hw->x[f];
-							priv->lastY[f]=hw->y[f];
-							break;
-						case RG_MODIFIER:
-							priv->fingerModes[f]=FM_MODIFIER;
-							break;
-						case RG_LEFTBTN:
-							priv->fingerModes[f]=FM_LEFTBTN;
-							break;
-						case RG_RIGHTBTN:
-							priv->fingerModes[f]=FM_RIGHTBTN;
-							break;
-						case RG_MIDDLEBTN:
-							priv->fingerModes[f]=FM_MIDDLEBTN;
-							break;
-					}
+		int f=ffs(pending)-1;
+
+		if(abs(hw->x[f]-priv->downX[f])>para->tap_move||abs(hw->y[f]-priv->downY[f])>para->tap_move)
+			priv->tap_moved= TRUE;
+	}
+	if(hw->pressed)
+		priv->tap_moved= TRUE;
+	tapped=!priv->tap_moved&&!expired;
+
+	switch(priv->tap_state)
+	{
+		case TS_SINGLETAP:
+			if(!expired&&!landed)
 				break;
-			case FM_MOVE:
-				if(region==RG_NULL)
-				{
-					priv->fingerModes[f]=FM_NULL;
-				}
+			tapButton(pInfo, priv->tap_button, FALSE);
+			priv->tap_state=TS_START;
+			/* fall through, a new finger starts the next tap */
+		case TS_START:
+			if(!landed||para->touchpad_off!=TOUCHPAD_ON)
 				break;
-			case FM_VERTSCROLL:
-				if(region==RG_NULL)
+			tapBegin(priv, TS_1, landed, para->tap_time);
+			tapped= TRUE;
+			/* fall through */
+		case TS_1:
+			priv->tap_max_fingers=MAX(priv->tap_max_fingers, fingers);
+			if(!tapped)
+				priv->tap_state=TS_MOVE;
+			else if(fingers==0)
+			{
+				int button=tapButtons[MIN(priv->tap_max_fingers, 3)];
+
+				if(!button)
 				{
-					priv->fingerModes[f]=FM_NULL;
+					priv->tap_state=TS_START;
+					break;
 				}
+				tapButton(pInfo, button, TRUE);
+				if(para->tap_and_drag_gesture&&button==1)
+					priv->tap_state=TS_2A;
+				else
+					priv->tap_state=TS_SINGLETAP;
+				priv->tap_deadline=now+(priv->tap_state==TS_2A ? para->single_tap_timeout : para->click_time);
 				break;
-			case FM_HORIZSCROLL:
-				if(region==RG_NULL)
+			}
+			/* fall through */
+		case TS_MOVE:
+			if(fingers==0)
+				priv->tap_state=TS_START;
+			break;
+		case TS_2A:
+			if(!landed)
+			{
+				if(expired)
 				{
-					priv->fingerModes[f]=FM_NULL;
+					tapButton(pInfo, priv->tap_button, FALSE);
+					priv->tap_state=TS_START;
 				}
 				break;
+			}
+			tapBegin(priv, TS_3, landed, para->tap_time_2);
+			tapped= TRUE;
+			/* fall through */
+		case TS_3:
+			if(fingers==0&&tapped)
+			{
+				/* double tap, the second click has the rest of ClickTime */
+				int button=priv->tap_button;
 
-			case FM_RIGHTBTN:
-				if(region==RG_NULL)
-				{
-					priv->fingerModes[f]=FM_NULL;
-				}
-				else if(region==RG_LEFTBTN)
-				{
-					priv->fingerModes[f]=FM_LEFTBTN;
-				}
-				else if(region==RG_MIDDLEBTN)
-				{
-					priv->fingerModes[f]=FM_MIDDLEBTN;
-				}
-				break;
-			case FM_LEFTBTN:
-				if(region==RG_NULL)
-				{
-					priv->fingerModes[f]=FM_NULL;
-				}
-				else if(region==RG_RIGHTBTN)
-				{
-					priv->fingerModes[f]=FM_RIGHTBTN;
-				}
-				else if(region==RG_MIDDLEBTN)
-				{
-					priv->fingerModes[f]=FM_MIDDLEBTN;
-				}
+				tapButton(pInfo, button, FALSE);
+				tapButton(pInfo, button, TRUE);
+				priv->tap_state=TS_SINGLETAP;
+				priv->tap_deadline=now+para->click_time;
 				break;
-			case FM_MIDDLEBTN:
-				if(region==RG_NULL)
-				{
-					priv->fingerModes[f]=FM_NULL;
-				}
-				else if(region==RG_LEFTBTN)
-				{
-					priv->fingerModes[f]=FM_LEFTBTN;
-				}
-				else if(region==RG_RIGHTBTN)
-				{
-					priv->fingerModes[f]=FM_RIGHTBTN;
-				}
+			}
+			if(!tapped)
+				priv->tap_state=TS_DRAG;
+			/* fall through */
+		case TS_DRAG:
+			if(fingers!=0||priv->tap_state!=TS_DRAG)
 				break;
-			case FM_MODIFIER:
-				if(region==RG_NULL)
+			if(para->locked_drags)
+			{
+				priv->tap_state=TS_4;
+				priv->tap_deadline=now+para->locked_drag_time;
+			}
+			else
+			{
+				tapButton(pInfo, priv->tap_button, FALSE);
+				priv->tap_state=TS_START;
+			}
+			break;
+		case TS_4:
+			if(!landed)
+			{
+				if(expired)
 				{
-					priv->fingerModes[f]=FM_NULL;
+					tapButton(pInfo, priv->tap_button, FALSE);
+					priv->tap_state=TS_START;
 				}
 				break;
+			}
+			tapBegin(priv, TS_5, landed, para->tap_time);
+			tapped= TRUE;
+			/* fall through */
+		case TS_5:
+			if(fingers==0&&tapped)
+			{
+				/* a tap ends a locked drag */
+				tapButton(pInfo, priv->tap_button, FALSE);
+				priv->tap_state=TS_START;
+			}
+			else if(fingers==0)
+			{
+				priv->tap_state=TS_4;
+				priv->tap_deadline=now+para->locked_drag_time;
+			}
+			else if(!tapped)
+				priv->tap_state=TS_DRAG;
+			break;
+	}
+
+	switch(priv->tap_state)
+	{
+		case TS_2A:
+		case TS_4:
+		case TS_SINGLETAP:
+			return MAX((int)(priv->tap_deadline-now), 1);
+		default:
+			return 0;
+	}
+}
+
+static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 now, Bool from_timer)
+{
+	SynapticsPrivate *priv=(SynapticsPrivate *) (pInfo->private);
+	const SynapticsParameters *para=&priv->cfg->para;
+	int delay=0;
+	int timeleft;
+	double dx=0, dy=0, scH=0, scV=0;
+	double liftH=0, liftV=0;
+	double backX=0, backY=0;	/* prediction leads taken back, posted units */
+	unsigned int predicted=0;
+	unsigned int landed=0;
+	Bool inside_active_area;
+
+	/* Only slots that got events this report can have moved or changed
+	 region; every other slot still has lastX/lastY equal to its position
+	 and contributes nothing below. */
+	unsigned int valid=(1U<<priv->num_slots)-1;
+	unsigned int stale;
+	unsigned int dirty;
+	unsigned int pending;
+
+	/* fingers at rest may be in a different region with a new layout,
+	 other changes don't affect them */
+	if(priv->cfg->regions_serial!=priv->regions_serial)
+	{
+		priv->staleSlots=~0U;
+		priv->regions_serial=priv->cfg->regions_serial;
+	}
+	stale=priv->staleSlots&valid;
+	dirty=(hw->dirty&valid)|stale;
+	priv->staleSlots=0;
+
+	//Palm rejection, decided once when a touch lands and kept until it lifts
+	if(para->palm_detect)
+	{
+		for(pending=dirty&~(priv->touchSlots|priv->palmSlots); pending; pending&=pending-1)
+		{
+			int f=ffs(pending)-1;
+
+			/* both, a fingertip pressing hard is still a finger */
+			if(hw->finger[f]&&hw->z[f]>para->palm_min_z&&hw->w[f]>para->palm_min_width)
+				priv->palmSlots|=1U<<f;
+		}
+	}
+	for(pending=dirty&priv->palmSlots; pending; pending&=pending-1)
+	{
+		int f=ffs(pending)-1;
+
+		if(!hw->finger[f])
+			priv->palmSlots&=~(1U<<f);
+	}
+	/* a palm never gets a finger mode, so nothing below needs to see it */
+	dirty&=~priv->palmSlots;
+
+	//Jump filter and noise cancellation, for fingers that were already down
+	for(pending=dirty&priv->touchSlots; pending; pending&=pending-1)
+	{
+		int f=ffs(pending)-1;
+
+		if(!hw->finger[f])
+			continue;
+		/* a finger swapped for another: carry on from where the new one
+		 is instead of posting the distance between them. The slot keeps
+		 its touch, so the mode follows the new region like for any move
+		 and the tap machine sees a finger that moved too far to tap. */
+		if(fingerJumped(para, hw->x[f]-priv->lastX[f], hw->y[f]-priv->lastY[f]))
+		{
+			priv->lastX[f]=hw->x[f];
+			priv->lastY[f]=hw->y[f];
+			priv->moveHist[f].head=0;
+			/* hand back the lead predicted from the old finger */
+			backX+=priv->predX[f];
+			backY+=priv->predY[f];
+			priv->predX[f]=priv->predY[f]=0;
+			priv->predictSlots&=~(1U<<f);
+			atomic_fetch_add_explicit(&priv->jumps, 1, memory_order_relaxed);
+			continue;
+		}
+		hw->x[f]=hysteresis(hw->x[f], priv->lastX[f], para->hyst_x);
+		hw->y[f]=hysteresis(hw->y[f], priv->lastY[f], para->hyst_y);
+		/* jitter within the box, nothing to do for this finger */
+		if(hw->x[f]==priv->lastX[f]&&hw->y[f]==priv->lastY[f]&&!(stale&(1U<<f)))
+			dirty&=~(1U<<f);
+	}
+
+	//Finger mode processing, only for fingers that changed region
+	unsigned int changed=0;
+	for(pending=dirty; pending; pending&=pending-1)
+	{
+		int f=ffs(pending)-1;
+		enum SynapticsRegion region=hw->finger[f] ? getRegionAt(priv, hw->x[f], hw->y[f]) : RG_NULL;
+
+		if(hw->finger[f]&&!(priv->touchSlots&(1U<<f)))
+		{
+			landed|=1U<<f;
+			priv->downX[f]=hw->x[f];
+			priv->downY[f]=hw->y[f];
+			priv->downTime[f]=now;
 		}
+
+		changed|=(region!=priv->lastRegion[f])<<f;
+		priv->lastRegion[f]=region;
+	}
+	while(changed)
+	{
+		int f=ffs(changed)-1;
+		enum FingerMode mode=fingerModeTransitions[priv->fingerModes[f]][priv->lastRegion[f]];
+
+		changed&=changed-1;
+		/* a scrolling finger leaving the pad may start coasting */
+		if(mode==FM_NULL&&(priv->fingerModes[f]==FM_VERTSCROLL||priv->fingerModes[f]==FM_HORIZSCROLL))
+		{
+			double vx, vy;
+
+			moveHistVelocity(&priv->moveHist[f], hw->usec, &vx, &vy);
+			if(priv->fingerModes[f]==FM_VERTSCROLL)
+				liftV+=vy;
+			else
+				liftH+=vx;
+		}
+		/* hand back the prediction lead of a finger that stops moving the
+		 pointer, so it ends up where the finger actually went */
+		if(priv->predictSlots&(1U<<f))
+		{
+			backX+=priv->predX[f];
+			backY+=priv->predY[f];
+			priv->predX[f]=priv->predY[f]=0;
+			priv->predictSlots&=~(1U<<f);
+		}
+		if(mode!=priv->fingerModes[f]&&(FM_ANCHORED&(1<<mode)))
+		{
+			priv->lastX[f]=hw->x[f];
+			priv->lastY[f]=hw->y[f];
+			priv->moveHist[f].head=0;
+		}
+		priv->modeSlots[priv->fingerModes[f]]&=~(1U<<f);
+		priv->modeSlots[mode]|=1U<<f;
+		priv->fingerModes[f]=mode;
 	}
 
 //	xf86DrvMsg(pInfo, X_PROBED, "X=%d; Y=%d; REGION: %d\n", hw->x[0], hw->y[0], priv->fingerModes[0]);
@@ -1127,22 +2109,42 @@ static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 n
 //	}
 
 //Movement processing
-	Bool mod = FALSE;
-	for(int finger=0; finger<5; finger++){
-		if(priv->fingerModes[finger]==FM_MODIFIER)
-			mod=TRUE;
-	}
-	int movingFingers = 0;
+	Bool mod=priv->modeSlots[FM_MODIFIER]!=0;
+	int movingFingers=Ones(priv->modeSlots[FM_MOVE]);
 	double factor=1;
-	for(int f=0; f<5; f++)
+	double velX=0, velY=0;
+	/* fingers still leading the pointer are revisited until the lead is
+	 gone, with or without reports */
+	for(pending=(dirty&(priv->modeSlots[FM_MOVE]|priv->modeSlots[FM_VERTSCROLL]|priv->modeSlots[FM_HORIZSCROLL]))|priv->predictSlots; pending; pending&=pending-1)
 	{
+		int f=ffs(pending)-1;
+		/* a stale slot without a report is at rest, not a new sample */
+		Bool moved=((dirty&(hw->dirty|~stale))>>f)&1;
+
+		/* scrolling fingers keep a history too, for their lift-off speed */
+		if(moved)
+			moveHistPush(&priv->moveHist[f], hw->x[f], hw->y[f], hw->usec);
 		switch(priv->fingerModes[f])
 		{
 			case FM_MOVE:
-				dx+=hw->x[f]-priv->lastX[f];
-				dy+=hw->y[f]-priv->lastY[f];
-				movingFingers++;
+			{
+				double gain=pressureGain(priv, hw->z[f]);
+				double vx, vy;
+
+				moveHistVelocity(&priv->moveHist[f], hw->usec, &vx, &vy);
+				vx*=gain;
+				vy*=gain;
+				if(moved)
+				{
+					dx+=(hw->x[f]-priv->lastX[f])*gain;
+					dy+=(hw->y[f]-priv->lastY[f])*gain;
+				}
+				predictMotion(priv, f, vx, vy, &backX, &backY);
+				predicted|=1U<<f;
+				velX+=vx;
+				velY+=vy;
 				break;
+			}
 			case FM_VERTSCROLL:
 				scV+=hw->y[f]-priv->lastY[f];
 				break;
@@ -1162,6 +2164,36 @@ static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 n
 	dy*=factor;
 	scH*=factor;
 	scV*=factor;
+	/* the speed of the pointer motion posted, for the acceleration profile */
+	priv->velocity=hypot(velX, velY)*factor;
+
+	/* post the change of the prediction leads; dix multiplies this
+	 report's motion by the profile's gain at the velocity just set */
+	if(predicted||backX!=0||backY!=0)
+	{
+		double gain=accelCurveGain(priv->cfg->accel, priv->velocity*ACCEL_VELOCITY_UNIT_MS);
+
+		for(pending=predicted; pending; pending&=pending-1)
+		{
+			int f=ffs(pending)-1;
+
+			dx+=priv->predX[f]*factor;
+			dy+=priv->predY[f]*factor;
+			priv->predX[f]*=factor*gain;
+			priv->predY[f]*=factor*gain;
+		}
+		dx-=backX/gain;
+		dy-=backY/gain;
+	}
+
+	//Coasting, until a finger touches down
+	if(landed)
+		priv->coastSpeedH=priv->coastSpeedV=0;
+	else if(liftH!=0||liftV!=0)
+		SynapticsStartCoasting(priv, liftH*factor, liftV*factor, now);
+	delay=SynapticsCoast(priv, now, &scH, &scV);
+	if(priv->predictSlots)
+		delay=mergeDelay(delay, PREDICT_INTERVAL);
 
 	dx+=priv->fracX;
 	dy+=priv->fracY;
@@ -1172,17 +2204,32 @@ static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 n
 	
 
 //	xf86DrvMsg(pInfo, X_PROBED, "DX=%d;DY=%d\n", dx,dy);
-	if(dx!=0||dy!=0)
-		xf86PostMotionEvent(pInfo->dev, 0, 0, 2, outX, outY);
+	/* one event per report for pointer motion and both scroll axes; the
+	 scroll axes take doubles, the server keeps what's left of an increment */
+	ValuatorMask *mask=priv->scroll_events_mask;
+	valuator_mask_zero(mask);
+	if(outX!=0||outY!=0)
+	{
+		valuator_mask_set(mask, 0, outX);
+		valuator_mask_set(mask, 1, outY);
+	}
 	if(scH!=0)
-		xf86PostMotionEvent(pInfo->dev, 0, 2, 1, (int)scH);
+		valuator_mask_set_double(mask, priv->scroll_axis_horiz, scH);
 	if(scV!=0)
-		xf86PostMotionEvent(pInfo->dev, 0, 3, 1, (int)scV);
+		valuator_mask_set_double(mask, priv->scroll_axis_vert, scV);
+	if(valuator_mask_num_valuators(mask))
+		xf86PostMotionEventM(pInfo->dev, 0, mask);
 	//Save values
-	for(int f=0; f<5; f++)
+	for(pending=dirty; pending; pending&=pending-1)
 	{
+		int f=ffs(pending)-1;
+
 		priv->lastX[f]=hw->x[f];
 		priv->lastY[f]=hw->y[f];
+		if(hw->finger[f])
+			priv->touchSlots|=1U<<f;
+		else
+			priv->touchSlots&=~(1U<<f);
 	}
 
 	//Button processing
@@ -1196,22 +2243,9 @@ static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 n
 	}
 	else if(hw->pressed)
 	{
-		Bool LB= FALSE, MB= FALSE, RB= FALSE;
-		for(int finger=0; finger<5; finger++)
-		{
-			switch(priv->fingerModes[finger])
-			{
-				case FM_LEFTBTN:
-					LB= TRUE;
-					break;
-				case FM_MIDDLEBTN:
-					MB= TRUE;
-					break;
-				case FM_RIGHTBTN:
-					RB= TRUE;
-					break;
-			}
-		}
+		Bool LB=priv->modeSlots[FM_LEFTBTN]!=0;
+		Bool MB=priv->modeSlots[FM_MIDDLEBTN]!=0;
+		Bool RB=priv->modeSlots[FM_RIGHTBTN]!=0;
 		if((LB&&!MB&&!RB)||
 				(!LB&&!MB&&!RB))
 		{
@@ -1233,6 +2267,7 @@ static int HandleState(InputInfoPtr pInfo, struct SynapticsHwState *hw, CARD32 n
 		}
 
 	}
+	delay=mergeDelay(delay, SynapticsTap(pInfo, hw, now, dirty, landed));
 //	xf86DrvMsg(NULL, X_PROBED, "XDDDDDD %d\n",para->press_motion_min_z);
 	return delay;
 }
@@ -22,6 +22,8 @@
 #ifndef	_SYNAPTICSSTR_H_
 #define _SYNAPTICSSTR_H_
 
+#include <stdatomic.h>
+
 #include "synproto.h"
 
 #if GET_ABI_MAJOR(ABI_XINPUT_VERSION) < 18
@@ -55,10 +57,18 @@
  *		Definitions
  *					structs, typedefs, #defines, enums
  *****************************************************************************/
-#define SYNAPTICS_MOVE_HISTORY	5
+#define SYNAPTICS_MOVE_HISTORY	8       /* power of two */
 #define SYNAPTICS_MAX_TOUCHES	10
 #define SYN_MAX_BUTTONS 12      /* Max number of mouse buttons */
 
+/* Longest motion prediction horizon accepted, in ms */
+#define SYN_MAX_PREDICT_HORIZON 50
+
+/* Number of per-report latency samples kept, must be a power of two */
+#define SYN_LATENCY_SAMPLES 1024
+/* Values in the latency property: p50, p99, max for each of the three stages */
+#define SYN_LATENCY_NSTATS 9
+
 /* Minimum and maximum values for scroll_button_repeat */
 #define SBR_MIN 10
 #define SBR_MAX 1000
@@ -69,12 +79,46 @@ enum OffState {
     TOUCHPAD_TAP_OFF = 2,
 };
 
+enum TapState {
+    TS_START,                   /* no tap in progress */
+    TS_1,                       /* touching, may still become a tap */
+    TS_MOVE,                    /* touching, too long or too far for a tap */
+    TS_2A,                      /* tapped, button down, waiting for a drag */
+    TS_3,                       /* touching again, double tap or drag */
+    TS_DRAG,                    /* dragging with the button down */
+    TS_4,                       /* locked drag, finger up */
+    TS_5,                       /* touching in a locked drag, may end it */
+    TS_SINGLETAP,               /* button down for the rest of a click */
+};
+
 
 typedef struct _SynapticsMoveHist {
     int x, y;
-    CARD32 millis;
+    CARD64 usec;                /* kernel timestamp of the report */
 } SynapticsMoveHistRec;
 
+/* The last SYNAPTICS_MOVE_HISTORY positions of one touch */
+typedef struct _SynapticsMoveRing {
+    SynapticsMoveHistRec hist[SYNAPTICS_MOVE_HISTORY];
+    unsigned int head;          /* samples written since the touch was anchored */
+} SynapticsMoveRingRec;
+
+typedef struct _SynapticsLatencySample {
+    CARD32 read;                /* kernel timestamp to driver read, in us */
+    CARD32 post;                /* driver read to events posted, in us */
+} SynapticsLatencySampleRec;
+
+/*
+ * Single-producer ring of latency samples. Only the input thread writes
+ * samples and head, only the main thread writes reset; the main thread
+ * never blocks the input thread to read it.
+ */
+typedef struct _SynapticsLatency {
+    SynapticsLatencySampleRec samples[SYN_LATENCY_SAMPLES];
+    atomic_uint head;           /* number of samples ever recorded */
+    atomic_uint reset;          /* value of head when stats were last reset */
+} SynapticsLatencyRec;
+
 typedef struct _SynapticsTouchAxis {
     const char *label;
     int min;
@@ -104,6 +148,62 @@ enum SynapticsRegion{
 	RG_MODIFIER,
 };
 
+/* Grid value of cells crossed by a region edge */
+#define SYN_REGION_BOUNDARY 0xff
+#define SYN_MAX_REGION_AREAS 8
+
+/* One entry of the region table, a rectangle or a circle if r > 0 */
+typedef struct _SynapticsRegionArea {
+    enum SynapticsRegion region;
+    int x0, y0, x1, y1;         /* inclusive bounds, or the centre in x0/y0 */
+    int r;                      /* radius of a circle */
+} SynapticsRegionAreaRec;
+
+/*
+ * The region layout compiled for classification: the area table, checked
+ * in order with RG_MOVE for points outside all areas, and a coarse grid
+ * over the pad. Each grid cell holds the region all of its points fall
+ * into, or SYN_REGION_BOUNDARY if they don't agree and the table must be
+ * consulted. Rebuilt as a whole whenever the layout changes.
+ */
+typedef struct _SynapticsRegionMap {
+    int minx, miny;             /* points above or left of this are RG_NULL */
+    int nareas;
+    SynapticsRegionAreaRec areas[SYN_MAX_REGION_AREAS];
+    unsigned int shift;         /* cells are (1 << shift) units square */
+    unsigned int cols, rows;
+    unsigned char cells[];      /* rows * cols, row-major */
+} SynapticsRegionMapRec;
+
+#define SYN_ACCEL_MAX_POINTS 16
+
+/* A control point of the acceleration curve */
+typedef struct _SynapticsAccelPoint {
+    double velocity;
+    double gain;
+    double slope;               /* gain per unit of velocity up to the next point */
+} SynapticsAccelPointRec;
+
+/*
+ * Pointer acceleration as a monotonic piecewise-linear function of
+ * velocity, flat before the first and after the last point. Rebuilt as a
+ * whole whenever the parameters it's made from change.
+ */
+typedef struct _SynapticsAccelCurve {
+    int npoints;
+    SynapticsAccelPointRec points[SYN_ACCEL_MAX_POINTS];
+} SynapticsAccelCurveRec;
+
+/*
+ * Motion gain for every pressure the device can report, from the
+ * PressureMotion parameters. Rebuilt whenever they change.
+ */
+typedef struct _SynapticsPressureGain {
+    int minp;                   /* pressure of the first entry */
+    int size;
+    float gain[];
+} SynapticsPressureGainRec;
+
 typedef struct _SynapticsParameters {
     /* Parameter data */
     int left_edge, right_edge, top_edge, bottom_edge;   /* edge coordinates absolute */
@@ -128,6 +228,8 @@ typedef struct _SynapticsParameters {
     Bool scroll_twofinger_vert; /* Enable/disable vertical two-finger scrolling */
     Bool scroll_twofinger_horiz;        /* Enable/disable horizontal two-finger scrolling */
     double min_speed, max_speed, accl;  /* movement parameters */
+    int accel_npoints;          /* user-defined curve points, 0 to use the above */
+    float accel_points[SYN_ACCEL_MAX_POINTS][2];        /* velocity, gain */
 
     Bool updown_button_scrolling;       /* Up/Down-Button scrolling or middle/double-click */
     Bool leftright_button_scrolling;    /* Left/right-button scrolling, or two lots of middle button */
@@ -165,28 +267,87 @@ typedef struct _SynapticsParameters {
     int hyst_x, hyst_y;         /* x and y width of hysteresis box */
 
     int maxDeltaMM;               /* maximum delta movement (vector length) in mm */
+    Bool latency_trace;         /* record per-report input latency */
+    int predict_horizon;        /* ms to extrapolate pointer motion ahead, 0 = off */
+
+    /* region layout, absolute coordinates */
+    int vertscroll_width;       /* vertical scroll strip along the right edge */
+    int horizscroll_height;     /* horizontal scroll strip along the top edge */
+    int buttons_top;            /* first row of the button area */
+    int middlebtn_top, middlebtn_bottom;        /* rows of the middle button */
+    int middlebtn_width;        /* width of the middle button, centred */
+    int modifier_radius;        /* modifier area around the top-left corner */
 } SynapticsParameters;
 
+/*
+ * The tables built from the parameters, a bit each. Every property says
+ * which of them its parameters feed, a change rebuilds just those and
+ * shares the others with the config it replaces.
+ */
+#define SYN_DERIVED_REGIONS     (1 << 0)        /* region map, from the layout */
+#define SYN_DERIVED_ACCEL       (1 << 1)        /* accel curve, from the speeds or points */
+#define SYN_DERIVED_PRESSURE    (1 << 2)        /* pressure gains, from PressureMotion */
+#define SYN_DERIVED_ALL         ((1 << 3) - 1)
+
+/*
+ * What the input thread reads of the configuration: a copy of the
+ * parameters and the tables built from them. Never changed once
+ * published, the main thread builds a new one for every change.
+ */
+typedef struct _SynapticsConfig {
+    SynapticsParameters para;
+    SynapticsRegionMapRec *regions;     /* compiled region layout */
+    SynapticsAccelCurveRec *accel;      /* compiled acceleration curve */
+    SynapticsPressureGainRec *pressureGain;     /* compiled pressure gains */
+    unsigned int regions_serial;        /* bumped when the region map is rebuilt */
+    struct _SynapticsConfig *next;      /* on the retired list */
+} SynapticsConfigRec;
+
 struct _SynapticsPrivateRec {
 
     SynapticsParameters synpara;        /* Default parameter settings, read from
-                                           the X config file */\
+                                           the X config file, main thread only */\
+
+    /* The input thread reads the config published by the main thread.
+       Whichever config it is pinning for the current pass is never freed. */
+    SynapticsConfigRec *_Atomic config;
+    SynapticsConfigRec *_Atomic config_pinned;
+    SynapticsConfigRec *config_retired;         /* replaced, maybe still pinned */
+    SynapticsConfigRec *cfg;    /* input thread: the pinned config, or NULL */
+    unsigned int regions_serial;        /* input thread: region map last seen */
 
     struct SynapticsProtocolOperations *proto_ops;
     void *proto_data;           /* protocol-specific data */
 
-    enum FingerMode fingerModes[5];
+    int num_slots;              /* touch slots tracked, from the device */
+    /* per-slot state, num_slots entries each, allocated as one block */
+    SynapticsMoveRingRec *moveHist;     /* recent positions, for velocity */
+    double *predX, *predY;      /* lead of the pointer over the finger, posted units */
+    enum FingerMode *fingerModes;
+    enum SynapticsRegion *lastRegion;   /* region seen on the last report */
+    int *lastX;
+    int *lastY;
+    int *downX, *downY;         /* where each finger touched down */
+    CARD32 *downTime;           /* and when */
+    unsigned int modeSlots[FM_MODIFIER + 1];    /* slots in each finger mode */
+    unsigned int staleSlots;    /* slots to reprocess whether dirty or not */
+    unsigned int touchSlots;    /* slots with a finger on the last report */
+    unsigned int predictSlots;  /* slots with a prediction lead */
+    unsigned int palmSlots;     /* slots ignored as palms until they lift */
     Bool ongoingBtnPress;
     int OngoingBtnId;
-    int lastX[5];
-    int lastY[5];
     double fracX;
     double fracY;
+    double velocity;            /* pointer speed in units/ms, for the accel profile */
+    double coastSpeedH, coastSpeedV;    /* coasting speeds in units/ms, 0 if not coasting */
+    CARD32 coastTime;           /* when coasting was last advanced */
 
 
     struct SynapticsHwState *hwState;
     const char *device;         /* device node */
     CARD32 timer_time;          /* when timer last fired */
+    CARD32 timer_deadline;      /* when the armed timer fires */
+    Bool timer_armed;
     OsTimerPtr timer;           /* for up/down-button repeat, tap processing, etc */
     struct CommData comm;
     struct SynapticsHwState *local_hw_state;    /* used in place of local hw state variables */
@@ -194,14 +355,26 @@ struct _SynapticsPrivateRec {
     int button_delay_millis;    /* button delay for 3rd button emulation */
     Bool prev_up;               /* Previous up button value, for double click emulation */
     CARD32 last_motion_millis;  /* time of the last motion */
+    enum TapState tap_state;
+    CARD32 tap_start;           /* touch-down of the current tap candidate */
+    CARD32 tap_deadline;        /* when the current tap state times out */
+    Bool tap_moved;             /* a finger left the MaxTapMove box */
     int tap_max_fingers;        /* Max number of fingers seen since entering start state */
     int tap_button;             /* Which button started the tap processing */
+    int minx, maxx, miny, maxy; /* min/max dimensions as detected */
+    int minp, maxp, minw, maxw; /* pressure and contact size ranges */
     int resx, resy;             /*resolution of coordinates as detected in units/mm */
     int scroll_axis_horiz;      /* Horizontal smooth-scrolling axis */
     int scroll_axis_vert;       /* Vertical smooth-scrolling axis */
-    ValuatorMask *scroll_events_mask;   /* ValuatorMask for smooth-scrolling */
-
-
+    ValuatorMask *scroll_events_mask;   /* motion and smooth-scrolling, posted together */
+    SynapticsLatencyRec latency;        /* samples for the latency property */
+    Bool prop_refresh;          /* the driver is updating a read-only property */
+    atomic_uint jumps;          /* reports a finger moved more than MaxDeltaMM in */
 };
 
+extern Bool SynapticsPublishConfig(SynapticsPrivate * priv, unsigned int rebuild);
+extern void SynapticsLatencyReset(SynapticsLatencyRec *lat);
+extern void SynapticsLatencyStats(SynapticsLatencyRec *lat,
+                                  CARD32 stats[SYN_LATENCY_NSTATS]);
+
 #endif                          /* _SYNAPTICSSTR_H_ */
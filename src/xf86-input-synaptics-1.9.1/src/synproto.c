@@ -25,15 +25,38 @@
 #include "synapticsstr.h"
 
 
+static size_t
+SynapticsHwStateSize(int num_slots)
+{
+    return sizeof(struct SynapticsHwState) +
+        num_slots * (4 * sizeof(int) + sizeof(Bool));
+}
+
+/* Point the per-slot arrays into the block behind the struct */
+static void
+SynapticsHwStateSetSlots(struct SynapticsHwState *hw)
+{
+    int n = hw->num_slots;
+
+    hw->x = (int *) (hw + 1);
+    hw->y = hw->x + n;
+    hw->z = hw->y + n;
+    hw->w = hw->z + n;
+    hw->finger = (Bool *) (hw->w + n);
+}
+
 struct SynapticsHwState *
 SynapticsHwStateAlloc(SynapticsPrivate * priv)
 {
     struct SynapticsHwState *hw;
 
-    hw = calloc(1, sizeof(struct SynapticsHwState));
+    hw = calloc(1, SynapticsHwStateSize(priv->num_slots));
     if (!hw)
         return NULL;
 
+    hw->num_slots = priv->num_slots;
+    SynapticsHwStateSetSlots(hw);
+
     return hw;
 }
 
@@ -44,22 +67,29 @@ SynapticsHwStateFree(struct SynapticsHwState **hw)
     *hw = NULL;
 }
 
+/* Both states must have been allocated for the same number of slots */
 void
 SynapticsCopyHwState(struct SynapticsHwState *dst,
                      const struct SynapticsHwState *src)
 {
-    memcpy(dst, src, sizeof(struct SynapticsHwState));
+    memcpy(dst, src, SynapticsHwStateSize(src->num_slots));
+    SynapticsHwStateSetSlots(dst);
 }
 
 void
 SynapticsResetHwState(struct SynapticsHwState *hw)
 {
-    memset(hw, 0, sizeof (struct SynapticsHwState));
-    for(int f=0; f<5;f++)
+    int num_slots = hw->num_slots;
+
+    memset(hw, 0, SynapticsHwStateSize(num_slots));
+    hw->num_slots = num_slots;
+    SynapticsHwStateSetSlots(hw);
+    for(int f=0; f<num_slots;f++)
     {
     	hw->x[f]=-1;
     	hw->y[f]=-1;
     	hw->z[f]=-1;
+    	hw->w[f]=-1;
     }
 }
 
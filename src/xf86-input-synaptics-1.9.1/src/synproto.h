@@ -61,11 +61,16 @@ enum SynapticsSlotState {
  */
 struct SynapticsHwState {
     CARD32 millis;              /* Timestamp in milliseconds */
+    CARD64 usec;                /* Timestamp in microseconds */
+    int num_slots;              /* Entries in each of the per-slot arrays */
     int fingersCount;
-    Bool finger[5];
-    int x[5];                      /* X position of finger */
-    int y[5];                      /* Y position of finger */
-    int z[5];                      /* Finger pressure */
+    unsigned int dirty;         /* Slots changed since the last report, a bit each */
+    /* Per-slot state, stored in one block right behind the struct */
+    Bool *finger;
+    int *x;                     /* X position of finger */
+    int *y;                     /* Y position of finger */
+    int *z;                     /* Finger pressure */
+    int *w;                     /* Contact size, touch or width major */
 //    int cumulative_dx;          /* Cumulative delta X for clickpad dragging */
 //    int cumulative_dy;          /* Cumulative delta Y for clickpad dragging */
 //    int numFingers;
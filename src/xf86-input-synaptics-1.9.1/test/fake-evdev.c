@@ -0,0 +1,312 @@
+/*
+ * Copyright © 2026 The xf86-input-synaptics contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A minimal libevdev replacement that reads plain input_event structs from
+ * whatever fd it is given (a pipe, in the replay harness) and answers
+ * capability queries from a description set up with fake_evdev_*().
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libevdev/libevdev.h>
+
+#include "fake-symbols.h"
+
+#define MAX_SLOTS 64
+#define QUEUE_SIZE 64
+#define ABS_MT_MIN ABS_MT_SLOT
+#define LONG_BITS (sizeof(long) * 8)
+#define NLONGS(x) (((x) + LONG_BITS - 1) / LONG_BITS)
+#define SET_BIT(bit, array) (array[(bit) / LONG_BITS] |= 1UL << ((bit) % LONG_BITS))
+#define TEST_BIT(bit, array) ((array[(bit) / LONG_BITS] >> ((bit) % LONG_BITS)) & 1)
+
+struct fake_evdev_desc {
+    char name[256];
+    unsigned long props[NLONGS(INPUT_PROP_CNT)];
+    unsigned long bits[EV_CNT][NLONGS(KEY_CNT)];
+    struct input_absinfo abs[ABS_CNT];
+};
+
+struct libevdev {
+    int fd;
+    int current_slot;
+    /* events are read in bulk, like libevdev does */
+    struct input_event queue[QUEUE_SIZE];
+    int queue_head, queue_tail;
+    struct fake_evdev_desc desc;
+    int mt_values[MAX_SLOTS][ABS_CNT - ABS_MT_MIN];
+};
+
+static struct fake_evdev_desc template;
+
+void
+fake_evdev_set_name(const char *name)
+{
+    strncpy(template.name, name, sizeof(template.name) - 1);
+}
+
+void
+fake_evdev_enable_property(unsigned int prop)
+{
+    if (prop < INPUT_PROP_CNT)
+        SET_BIT(prop, template.props);
+}
+
+void
+fake_evdev_enable_event_code(unsigned int type, unsigned int code)
+{
+    if (type >= EV_CNT || code >= KEY_CNT)
+        return;
+
+    SET_BIT(type, template.bits[0]);
+    if (type != EV_SYN)
+        SET_BIT(code, template.bits[type]);
+}
+
+void
+fake_evdev_set_abs_info(unsigned int code, const struct input_absinfo *abs)
+{
+    if (code >= ABS_CNT)
+        return;
+
+    fake_evdev_enable_event_code(EV_ABS, code);
+    template.abs[code] = *abs;
+}
+
+struct libevdev *
+libevdev_new(void)
+{
+    struct libevdev *dev = calloc(1, sizeof(*dev));
+
+    if (dev)
+        dev->fd = -1;
+    return dev;
+}
+
+int
+libevdev_new_from_fd(int fd, struct libevdev **dev)
+{
+    *dev = libevdev_new();
+    if (!*dev)
+        return -ENOMEM;
+    return libevdev_set_fd(*dev, fd);
+}
+
+void
+libevdev_free(struct libevdev *dev)
+{
+    free(dev);
+}
+
+int
+libevdev_set_fd(struct libevdev *dev, int fd)
+{
+    dev->fd = fd;
+    dev->desc = template;
+    dev->current_slot = dev->desc.abs[ABS_MT_SLOT].value;
+    return 0;
+}
+
+int
+libevdev_change_fd(struct libevdev *dev, int fd)
+{
+    dev->fd = fd;
+    dev->queue_head = dev->queue_tail = 0;
+    return 0;
+}
+
+int
+libevdev_get_fd(const struct libevdev *dev)
+{
+    return dev->fd;
+}
+
+int
+libevdev_next_event(struct libevdev *dev, unsigned int flags,
+                    struct input_event *ev)
+{
+    /* the replay never drops events, so there is never anything to sync */
+    if (flags & (LIBEVDEV_READ_FLAG_SYNC | LIBEVDEV_READ_FLAG_FORCE_SYNC))
+        return -EAGAIN;
+
+    if (dev->queue_head == dev->queue_tail) {
+        ssize_t len = read(dev->fd, dev->queue, sizeof(dev->queue));
+
+        if (len < 0)
+            return -errno;
+        if (len < (ssize_t) sizeof(*ev))
+            return -EAGAIN;
+        dev->queue_head = 0;
+        dev->queue_tail = len / sizeof(*ev);
+    }
+    *ev = dev->queue[dev->queue_head++];
+
+    if (ev->type == EV_SYN && ev->code == SYN_DROPPED)
+        return LIBEVDEV_READ_STATUS_SYNC;
+
+    if (ev->type == EV_ABS && ev->code < ABS_CNT) {
+        if (ev->code == ABS_MT_SLOT)
+            dev->current_slot = ev->value;
+        else if (ev->code >= ABS_MT_MIN && dev->current_slot >= 0 &&
+                 dev->current_slot < MAX_SLOTS)
+            dev->mt_values[dev->current_slot][ev->code - ABS_MT_MIN] =
+                ev->value;
+        dev->desc.abs[ev->code].value = ev->value;
+    }
+
+    return LIBEVDEV_READ_STATUS_SUCCESS;
+}
+
+int
+libevdev_has_event_pending(struct libevdev *dev)
+{
+    return 0;
+}
+
+int
+libevdev_grab(struct libevdev *dev, enum libevdev_grab_mode grab)
+{
+    return 0;
+}
+
+int
+libevdev_set_clock_id(struct libevdev *dev, clockid_t clockid)
+{
+    return 0;
+}
+
+int
+libevdev_get_current_slot(const struct libevdev *dev)
+{
+    return dev->current_slot;
+}
+
+int
+libevdev_get_num_slots(const struct libevdev *dev)
+{
+    if (!libevdev_has_event_code(dev, EV_ABS, ABS_MT_SLOT))
+        return -1;
+    return dev->desc.abs[ABS_MT_SLOT].maximum + 1;
+}
+
+const struct input_absinfo *
+libevdev_get_abs_info(const struct libevdev *dev, unsigned int code)
+{
+    if (!libevdev_has_event_code(dev, EV_ABS, code))
+        return NULL;
+    return &dev->desc.abs[code];
+}
+
+int
+libevdev_get_abs_minimum(const struct libevdev *dev, unsigned int code)
+{
+    const struct input_absinfo *abs = libevdev_get_abs_info(dev, code);
+
+    return abs ? abs->minimum : 0;
+}
+
+int
+libevdev_get_abs_maximum(const struct libevdev *dev, unsigned int code)
+{
+    const struct input_absinfo *abs = libevdev_get_abs_info(dev, code);
+
+    return abs ? abs->maximum : 0;
+}
+
+int
+libevdev_get_abs_resolution(const struct libevdev *dev, unsigned int code)
+{
+    const struct input_absinfo *abs = libevdev_get_abs_info(dev, code);
+
+    return abs ? abs->resolution : 0;
+}
+
+int
+libevdev_has_event_type(const struct libevdev *dev, unsigned int type)
+{
+    return type == EV_SYN || (type < EV_CNT && TEST_BIT(type, dev->desc.bits[0]));
+}
+
+int
+libevdev_has_event_code(const struct libevdev *dev, unsigned int type,
+                        unsigned int code)
+{
+    if (!libevdev_has_event_type(dev, type) || code >= KEY_CNT)
+        return 0;
+    return type == EV_SYN || TEST_BIT(code, dev->desc.bits[type]);
+}
+
+int
+libevdev_has_property(const struct libevdev *dev, unsigned int prop)
+{
+    return prop < INPUT_PROP_CNT && TEST_BIT(prop, dev->desc.props);
+}
+
+int
+libevdev_get_event_value(const struct libevdev *dev, unsigned int type,
+                         unsigned int code)
+{
+    if (type == EV_ABS && code < ABS_CNT)
+        return dev->desc.abs[code].value;
+    return 0;
+}
+
+int
+libevdev_get_slot_value(const struct libevdev *dev, unsigned int slot,
+                        unsigned int code)
+{
+    if (slot >= MAX_SLOTS || code < ABS_MT_MIN || code >= ABS_CNT)
+        return 0;
+    return dev->mt_values[slot][code - ABS_MT_MIN];
+}
+
+const char *
+libevdev_get_name(const struct libevdev *dev)
+{
+    return dev->desc.name;
+}
+
+void
+libevdev_set_device_log_function(struct libevdev *dev,
+                                 libevdev_device_log_func_t logfunc,
+                                 enum libevdev_log_priority priority,
+                                 void *data)
+{
+}
+
+void
+libevdev_set_log_function(libevdev_log_func_t logfunc, void *data)
+{
+}
+
+void
+libevdev_set_log_priority(enum libevdev_log_priority priority)
+{
+}
@@ -0,0 +1,840 @@
+/*
+ * Copyright © 2012 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <X11/Xatom.h>
+#include <xorg-server.h>
+#include <xf86.h>
+#include <xf86Xinput.h>
+#include <xf86Optionstr.h>
+#include <xisb.h>
+#include <exevents.h>
+#include <ptrveloc.h>
+
+#include "fake-symbols.h"
+
+#define MAX_ATOMS 256
+#define MAX_PROPERTIES 64
+
+int fake_serial_fd = -1;
+FILE *fake_event_log;
+unsigned long fake_events_posted;
+
+static CARD64 fake_time;
+
+/*****************************************************************************
+ * Clock and timers
+ ****************************************************************************/
+struct _OsTimerRec {
+    struct _OsTimerRec *next;
+    Bool armed;
+    CARD32 expires;
+    OsTimerCallback callback;
+    void *arg;
+};
+
+static OsTimerPtr timers;
+
+void
+fake_set_time(CARD64 usec)
+{
+    fake_time = usec;
+}
+
+CARD64
+fake_get_time(void)
+{
+    return fake_time;
+}
+
+CARD32
+GetTimeInMillis(void)
+{
+    return fake_time / 1000;
+}
+
+CARD64
+GetTimeInMicros(void)
+{
+    return fake_time;
+}
+
+OsTimerPtr
+TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
+         OsTimerCallback func, void *arg)
+{
+    if (!timer) {
+        timer = calloc(1, sizeof(*timer));
+        if (!timer)
+            return NULL;
+        timer->next = timers;
+        timers = timer;
+    }
+
+    timer->armed = FALSE;
+    if (!millis)
+        return timer;
+
+    timer->expires = (flags & TimerAbsolute) ? millis
+                                             : GetTimeInMillis() + millis;
+    timer->callback = func;
+    timer->arg = arg;
+    timer->armed = TRUE;
+
+    return timer;
+}
+
+void
+TimerCancel(OsTimerPtr timer)
+{
+    if (timer)
+        timer->armed = FALSE;
+}
+
+void
+TimerFree(OsTimerPtr timer)
+{
+    OsTimerPtr *t;
+
+    if (!timer)
+        return;
+
+    for (t = &timers; *t; t = &(*t)->next) {
+        if (*t == timer) {
+            *t = timer->next;
+            break;
+        }
+    }
+    free(timer);
+}
+
+void
+fake_run_timers(void)
+{
+    CARD64 now = fake_time;
+
+    /* fire in expiry order, each with the clock at its expiry time, so
+     * timers re-armed by a callback run again if they are due by now */
+    for (;;) {
+        OsTimerPtr t, next = NULL;
+        CARD32 millis;
+
+        for (t = timers; t; t = t->next) {
+            if (!t->armed || (int) (t->expires - (CARD32) (now / 1000)) > 0)
+                continue;
+            if (!next || (int) (t->expires - next->expires) < 0)
+                next = t;
+        }
+        if (!next)
+            break;
+
+        next->armed = FALSE;
+        fake_time = (CARD64) next->expires * 1000;
+        millis = next->callback(next, next->expires, next->arg);
+        if (millis)
+            TimerSet(next, 0, millis, next->callback, next->arg);
+        /* the callback may have re-armed or freed any timer */
+    }
+
+    fake_time = now;
+}
+
+void
+input_lock(void)
+{
+}
+
+void
+input_unlock(void)
+{
+}
+
+#if GET_ABI_MAJOR(ABI_XINPUT_VERSION) < 23
+int
+xf86BlockSIGIO(void)
+{
+    return 0;
+}
+
+void
+xf86UnblockSIGIO(int wasset)
+{
+}
+#endif
+
+/*****************************************************************************
+ * Logging
+ ****************************************************************************/
+static void
+fake_vlog(MessageType type, const char *prefix, const char *format,
+          va_list args)
+{
+    if (type != X_ERROR && type != X_WARNING)
+        return;
+
+    if (prefix)
+        fprintf(stderr, "%s: ", prefix);
+    vfprintf(stderr, format, args);
+}
+
+void
+xf86IDrvMsg(InputInfoPtr pInfo, MessageType type, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fake_vlog(type, pInfo->name, format, args);
+    va_end(args);
+}
+
+void
+xf86DrvMsg(int scrnIndex, MessageType type, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fake_vlog(type, NULL, format, args);
+    va_end(args);
+}
+
+void
+xf86MsgVerb(MessageType type, int verb, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fake_vlog(type, NULL, format, args);
+    va_end(args);
+}
+
+void
+xf86ErrorFVerb(int verb, const char *format, ...)
+{
+}
+
+void
+LogMessageVerbSigSafe(MessageType type, int verb, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fake_vlog(type, NULL, format, args);
+    va_end(args);
+}
+
+void
+LogVMessageVerbSigSafe(MessageType type, int verb, const char *format,
+                       va_list args)
+{
+    fake_vlog(type, NULL, format, args);
+}
+
+/*****************************************************************************
+ * Options
+ ****************************************************************************/
+static XF86OptionPtr
+fake_find_option(XF86OptionPtr list, const char *name)
+{
+    for (; list; list = (XF86OptionPtr) list->list.next)
+        if (strcasecmp(list->opt_name, name) == 0)
+            return list;
+    return NULL;
+}
+
+XF86OptionPtr
+xf86AddNewOption(XF86OptionPtr head, const char *name, const char *val)
+{
+    XF86OptionPtr opt = fake_find_option(head, name);
+
+    if (opt) {
+        free((char *) opt->opt_val);
+        opt->opt_val = strdup(val);
+        return head;
+    }
+
+    opt = calloc(1, sizeof(*opt));
+    if (!opt)
+        return head;
+    opt->opt_name = strdup(name);
+    opt->opt_val = strdup(val);
+    opt->list.next = (GenericListPtr) head;
+
+    return opt;
+}
+
+XF86OptionPtr
+xf86ReplaceStrOption(XF86OptionPtr optlist, const char *name, const char *val)
+{
+    return xf86AddNewOption(optlist, name, val);
+}
+
+const char *
+xf86FindOptionValue(XF86OptionPtr options, const char *name)
+{
+    XF86OptionPtr opt = fake_find_option(options, name);
+
+    return opt ? opt->opt_val : NULL;
+}
+
+char *
+xf86SetStrOption(XF86OptionPtr optlist, const char *name, const char *deflt)
+{
+    const char *val = xf86FindOptionValue(optlist, name);
+
+    if (!val)
+        val = deflt;
+    return val ? strdup(val) : NULL;
+}
+
+char *
+xf86CheckStrOption(XF86OptionPtr optlist, const char *name, const char *deflt)
+{
+    return xf86SetStrOption(optlist, name, deflt);
+}
+
+int
+xf86SetIntOption(XF86OptionPtr optlist, const char *name, int deflt)
+{
+    const char *val = xf86FindOptionValue(optlist, name);
+
+    return val ? strtol(val, NULL, 0) : deflt;
+}
+
+int
+xf86CheckIntOption(XF86OptionPtr optlist, const char *name, int deflt)
+{
+    return xf86SetIntOption(optlist, name, deflt);
+}
+
+double
+xf86SetRealOption(XF86OptionPtr optlist, const char *name, double deflt)
+{
+    const char *val = xf86FindOptionValue(optlist, name);
+
+    return val ? strtod(val, NULL) : deflt;
+}
+
+int
+xf86SetBoolOption(XF86OptionPtr optlist, const char *name, int deflt)
+{
+    const char *val = xf86FindOptionValue(optlist, name);
+
+    if (!val)
+        return deflt;
+
+    return strcasecmp(val, "on") == 0 || strcasecmp(val, "true") == 0 ||
+           strcasecmp(val, "yes") == 0 || strcmp(val, "1") == 0;
+}
+
+double
+xf86CheckPercentOption(XF86OptionPtr optlist, const char *name, double deflt)
+{
+    const char *val = xf86FindOptionValue(optlist, name);
+    char *end;
+    double percent;
+
+    if (!val)
+        return deflt;
+
+    percent = strtod(val, &end);
+    return (end != val && *end == '%') ? percent : deflt;
+}
+
+double
+xf86SetPercentOption(XF86OptionPtr optlist, const char *name, double deflt)
+{
+    return xf86CheckPercentOption(optlist, name, deflt);
+}
+
+void
+xf86ProcessCommonOptions(InputInfoPtr pInfo, XF86OptionPtr options)
+{
+}
+
+/*****************************************************************************
+ * Device handling
+ ****************************************************************************/
+int
+xf86OpenSerial(XF86OptionPtr options)
+{
+    return fake_serial_fd >= 0 ? dup(fake_serial_fd) : -1;
+}
+
+int
+xf86CloseSerial(int fd)
+{
+    return close(fd);
+}
+
+int
+xf86FlushInput(int fd)
+{
+    return 0;
+}
+
+XISBuffer *
+XisbNew(int fd, ssize_t size)
+{
+    XISBuffer *b = calloc(1, sizeof(XISBuffer));
+
+    if (b)
+        b->fd = fd;
+    return b;
+}
+
+void
+XisbFree(XISBuffer *b)
+{
+    free(b);
+}
+
+void
+xf86AddEnabledDevice(InputInfoPtr pInfo)
+{
+}
+
+void
+xf86RemoveEnabledDevice(InputInfoPtr pInfo)
+{
+}
+
+void
+xf86AddInputDriver(InputDriverPtr driver, pointer module, int flags)
+{
+}
+
+void
+xf86DeleteInput(InputInfoPtr pInp, int flags)
+{
+}
+
+Bool
+InitPointerDeviceStruct(DevicePtr device, CARD8 *map, int numButtons,
+                        Atom *btn_labels, PtrCtrlProcPtr controlProc,
+                        int numMotionEvents, int numAxes, Atom *axes_labels)
+{
+    return TRUE;
+}
+
+int
+GetMotionHistorySize(void)
+{
+    return 0;
+}
+
+static DeviceVelocityRec fake_velocity;
+
+DeviceVelocityPtr
+GetDevicePredictableAccelData(DeviceIntPtr dev)
+{
+    if (fake_velocity.const_acceleration == 0)
+        fake_velocity.const_acceleration = 1.0;
+    return &fake_velocity;
+}
+
+void
+SetDeviceSpecificAccelerationProfile(DeviceVelocityPtr vel,
+                                     PointerAccelerationProfileFunc profile)
+{
+    vel->deviceSpecificProfile = profile;
+}
+
+Bool
+SetScrollValuator(DeviceIntPtr dev, int axnum, enum ScrollType type,
+                  double increment, int flags)
+{
+    return TRUE;
+}
+
+/*****************************************************************************
+ * Valuator masks
+ ****************************************************************************/
+struct _ValuatorMask {
+    int last_bit;
+    unsigned char mask[(MAX_VALUATORS + 7) / 8];
+    double valuators[MAX_VALUATORS];
+};
+
+ValuatorMask *
+valuator_mask_new(int num_valuators)
+{
+    ValuatorMask *mask = calloc(1, sizeof(ValuatorMask));
+
+    if (mask)
+        mask->last_bit = -1;
+    return mask;
+}
+
+void
+valuator_mask_free(ValuatorMask **mask)
+{
+    free(*mask);
+    *mask = NULL;
+}
+
+void
+valuator_mask_zero(ValuatorMask *mask)
+{
+    memset(mask, 0, sizeof(*mask));
+    mask->last_bit = -1;
+}
+
+void
+valuator_mask_set_double(ValuatorMask *mask, int valuator, double data)
+{
+    mask->mask[valuator / 8] |= 1 << (valuator % 8);
+    mask->valuators[valuator] = data;
+    if (valuator > mask->last_bit)
+        mask->last_bit = valuator;
+}
+
+void
+valuator_mask_set(ValuatorMask *mask, int valuator, int data)
+{
+    valuator_mask_set_double(mask, valuator, data);
+}
+
+int
+valuator_mask_isset(const ValuatorMask *mask, int valuator)
+{
+    return mask->last_bit >= valuator &&
+           (mask->mask[valuator / 8] & (1 << (valuator % 8)));
+}
+
+void
+valuator_mask_unset(ValuatorMask *mask, int valuator)
+{
+    int i;
+
+    if (!valuator_mask_isset(mask, valuator))
+        return;
+
+    mask->mask[valuator / 8] &= ~(1 << (valuator % 8));
+    mask->valuators[valuator] = 0;
+    for (i = mask->last_bit; i >= 0; i--)
+        if (valuator_mask_isset(mask, i))
+            break;
+    mask->last_bit = i;
+}
+
+int
+valuator_mask_size(const ValuatorMask *mask)
+{
+    return mask->last_bit + 1;
+}
+
+int
+valuator_mask_num_valuators(const ValuatorMask *mask)
+{
+    int i, n = 0;
+
+    for (i = 0; i <= mask->last_bit; i++)
+        if (valuator_mask_isset(mask, i))
+            n++;
+    return n;
+}
+
+double
+valuator_mask_get_double(const ValuatorMask *mask, int valuator)
+{
+    return mask->valuators[valuator];
+}
+
+/*****************************************************************************
+ * Event posting
+ ****************************************************************************/
+void
+xf86PostMotionEvent(DeviceIntPtr device, int is_absolute,
+                    int first_valuator, int num_valuators, ...)
+{
+    va_list args;
+    int i;
+
+    fake_events_posted++;
+    if (!fake_event_log)
+        return;
+
+    fprintf(fake_event_log, "%u motion", (unsigned int) GetTimeInMillis());
+    va_start(args, num_valuators);
+    for (i = 0; i < num_valuators; i++)
+        fprintf(fake_event_log, " a%d=%d", first_valuator + i,
+                va_arg(args, int));
+    va_end(args);
+    fputc('\n', fake_event_log);
+}
+
+void
+xf86PostMotionEventM(DeviceIntPtr device, int is_absolute,
+                     const ValuatorMask *mask)
+{
+    int i;
+
+    fake_events_posted++;
+    if (!fake_event_log)
+        return;
+
+    fprintf(fake_event_log, "%u motion", (unsigned int) GetTimeInMillis());
+    for (i = 0; i < valuator_mask_size(mask); i++)
+        if (valuator_mask_isset(mask, i))
+            fprintf(fake_event_log, " a%d=%g", i,
+                    valuator_mask_get_double(mask, i));
+    fputc('\n', fake_event_log);
+}
+
+void
+xf86PostButtonEvent(DeviceIntPtr device, int is_absolute, int button,
+                    int is_down, int first_valuator, int num_valuators, ...)
+{
+    fake_events_posted++;
+    if (!fake_event_log)
+        return;
+
+    fprintf(fake_event_log, "%u button %d %s\n",
+            (unsigned int) GetTimeInMillis(), button,
+            is_down ? "press" : "release");
+}
+
+/*****************************************************************************
+ * Atoms and properties
+ ****************************************************************************/
+static char *atoms[MAX_ATOMS];
+static int natoms;
+
+struct fake_property {
+    DeviceIntPtr dev;
+    Atom atom;
+    XIPropertyValueRec value;
+};
+
+static struct fake_property properties[MAX_PROPERTIES];
+static int nproperties;
+
+static int (*fake_property_handler) (DeviceIntPtr dev, Atom property,
+                                     XIPropertyValuePtr prop,
+                                     BOOL checkonly);
+static int (*fake_property_get_handler) (DeviceIntPtr dev, Atom property);
+
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    int i;
+
+    for (i = 0; i < natoms; i++)
+        if (strlen(atoms[i]) == len && strncmp(atoms[i], string, len) == 0)
+            return XA_LAST_PREDEFINED + 1 + i;
+
+    if (!makeit || natoms == MAX_ATOMS)
+        return None;
+
+    atoms[natoms] = strndup(string, len);
+    return XA_LAST_PREDEFINED + 1 + natoms++;
+}
+
+const char *
+NameForAtom(Atom atom)
+{
+    if (atom <= XA_LAST_PREDEFINED ||
+        atom > (Atom) (XA_LAST_PREDEFINED + natoms))
+        return NULL;
+    return atoms[atom - XA_LAST_PREDEFINED - 1];
+}
+
+Atom
+XIGetKnownProperty(const char *name)
+{
+    return MakeAtom(name, strlen(name), TRUE);
+}
+
+static struct fake_property *
+fake_find_property(DeviceIntPtr dev, Atom atom)
+{
+    int i;
+
+    for (i = 0; i < nproperties; i++)
+        if (properties[i].dev == dev && properties[i].atom == atom)
+            return &properties[i];
+    return NULL;
+}
+
+int
+XIChangeDeviceProperty(DeviceIntPtr dev, Atom property, Atom type,
+                       int format, int mode, unsigned long len,
+                       const void *value, Bool sendevent)
+{
+    struct fake_property *p = fake_find_property(dev, property);
+    size_t size = len * (format / 8);
+    int rc;
+
+    /* like the server, the driver gets to check and apply every change,
+     * its own ones included */
+    if (fake_property_handler) {
+        XIPropertyValueRec prop;
+
+        prop.type = type;
+        prop.format = format;
+        prop.size = len;
+        prop.data = (void *) value;
+        rc = fake_property_handler(dev, property, &prop, TRUE);
+        if (rc != Success)
+            return rc;
+        rc = fake_property_handler(dev, property, &prop, FALSE);
+        if (rc != Success)
+            return rc;
+    }
+
+    if (!p) {
+        if (nproperties == MAX_PROPERTIES)
+            return BadAlloc;
+        p = &properties[nproperties++];
+        p->dev = dev;
+        p->atom = property;
+    }
+
+    free(p->value.data);
+    p->value.type = type;
+    p->value.format = format;
+    p->value.size = len;
+    p->value.data = malloc(size ? size : 1);
+    if (!p->value.data)
+        return BadAlloc;
+    memcpy(p->value.data, value, size);
+
+    return Success;
+}
+
+int
+XIGetDeviceProperty(DeviceIntPtr dev, Atom property, XIPropertyValuePtr *value)
+{
+    struct fake_property *p;
+
+    /* the driver may refresh the value before it is read */
+    if (fake_property_get_handler)
+        fake_property_get_handler(dev, property);
+
+    p = fake_find_property(dev, property);
+    if (!p)
+        return BadAtom;
+    *value = &p->value;
+    return Success;
+}
+
+int
+XISetDevicePropertyDeletable(DeviceIntPtr dev, Atom property, Bool deletable)
+{
+    return Success;
+}
+
+long
+XIRegisterPropertyHandler(DeviceIntPtr dev,
+                          int (*SetProperty) (DeviceIntPtr dev,
+                                              Atom property,
+                                              XIPropertyValuePtr prop,
+                                              BOOL checkonly),
+                          int (*GetProperty) (DeviceIntPtr dev,
+                                              Atom property),
+                          int (*DeleteProperty) (DeviceIntPtr dev,
+                                                 Atom property))
+{
+    fake_property_handler = SetProperty;
+    fake_property_get_handler = GetProperty;
+    return 1;
+}
+
+int
+fake_set_property(DeviceIntPtr dev, const char *name, const char *values)
+{
+    Atom atom = MakeAtom(name, strlen(name), FALSE);
+    struct fake_property *p = atom ? fake_find_property(dev, atom) : NULL;
+    Atom float_type = MakeAtom(XATOM_FLOAT, strlen(XATOM_FLOAT), TRUE);
+    XIPropertyValueRec prop;
+    unsigned char data[256];
+    const char *s = values;
+    long n = 0;
+
+    if (!p)
+        return BadName;
+
+    prop.type = p->value.type;
+    prop.format = p->value.format;
+    while (*s && (n + 1) * (prop.format / 8) <= (long) sizeof(data)) {
+        char *end;
+
+        if (prop.type == float_type)
+            ((float *) data)[n] = strtof(s, &end);
+        else if (prop.format == 8)
+            ((CARD8 *) data)[n] = strtol(s, &end, 0);
+        else if (prop.format == 16)
+            ((CARD16 *) data)[n] = strtol(s, &end, 0);
+        else
+            ((INT32 *) data)[n] = strtol(s, &end, 0);
+        if (end == s)
+            return BadValue;
+        n++;
+        s = (*end == ',') ? end + 1 : end;
+    }
+
+    return XIChangeDeviceProperty(dev, atom, prop.type, prop.format,
+                                  PropModeReplace, n, data, FALSE);
+}
+
+int
+fake_print_property(DeviceIntPtr dev, const char *name, FILE *out)
+{
+    Atom atom = MakeAtom(name, strlen(name), FALSE);
+    Atom float_type = MakeAtom(XATOM_FLOAT, strlen(XATOM_FLOAT), TRUE);
+    XIPropertyValuePtr value;
+    long i;
+    int rc;
+
+    if (!atom)
+        return BadName;
+    rc = XIGetDeviceProperty(dev, atom, &value);
+    if (rc != Success)
+        return rc;
+
+    fprintf(out, "%s =", name);
+    for (i = 0; i < value->size; i++) {
+        if (value->type == float_type)
+            fprintf(out, " %g", ((float *) value->data)[i]);
+        else if (value->format == 8)
+            fprintf(out, " %d", ((CARD8 *) value->data)[i]);
+        else if (value->format == 16)
+            fprintf(out, " %d", ((CARD16 *) value->data)[i]);
+        else if (value->type == XA_CARDINAL)
+            fprintf(out, " %u", ((CARD32 *) value->data)[i]);
+        else
+            fprintf(out, " %d", ((INT32 *) value->data)[i]);
+    }
+    fprintf(out, "\n");
+    return Success;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2012 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _FAKE_SYMBOLS_H_
+#define _FAKE_SYMBOLS_H_
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <linux/input.h>
+
+#include <xorg-server.h>
+#include <xf86.h>
+#include <xf86Xinput.h>
+
+/**
+ * Stand-ins for the server and libevdev so the driver can be driven
+ * outside of Xorg. The harness owns the clock, the file descriptor
+ * handed out by xf86OpenSerial() and the device description returned by
+ * libevdev; everything the driver posts is written to fake_event_log.
+ */
+
+/* fd handed out (dup'ed) by xf86OpenSerial */
+extern int fake_serial_fd;
+
+/* Posted events are dumped here, one per line. NULL discards them */
+extern FILE *fake_event_log;
+
+/* Number of events posted through xf86Post*Event */
+extern unsigned long fake_events_posted;
+
+/* Server time as returned by GetTimeInMillis/GetTimeInMicros */
+extern void fake_set_time(CARD64 usec);
+extern CARD64 fake_get_time(void);
+
+/* Fire all timers that expired at or before the current time */
+extern void fake_run_timers(void);
+
+/**
+ * Set a device property. XIChangeDeviceProperty runs the handler the
+ * driver registered the way the server does: check first, then apply.
+ * The values string is a comma-separated list that
+ * is converted according to the type and format of the property the
+ * driver initialized.
+ *
+ * @return Success or the X error code returned by the driver.
+ */
+extern int fake_set_property(DeviceIntPtr dev, const char *name,
+                             const char *values);
+
+/**
+ * Print "name = v1 v2 ..." for a device property, after letting the
+ * driver refresh it like a client read would.
+ *
+ * @return Success or the X error code.
+ */
+extern int fake_print_property(DeviceIntPtr dev, const char *name,
+                               FILE *out);
+
+/* Device description returned by the fake libevdev */
+extern void fake_evdev_set_name(const char *name);
+extern void fake_evdev_enable_property(unsigned int prop);
+extern void fake_evdev_enable_event_code(unsigned int type, unsigned int code);
+extern void fake_evdev_set_abs_info(unsigned int code,
+                                    const struct input_absinfo *abs);
+
+#endif                          /* _FAKE_SYMBOLS_H_ */
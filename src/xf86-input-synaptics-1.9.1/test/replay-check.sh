@@ -0,0 +1,23 @@
+#!/bin/sh
+#
+# Replays a recording through synaptics-replay and compares what the
+# driver posts with the expected output next to it, <name>.out. Extra
+# arguments for synaptics-replay, one per line, go in <name>.args.
+#
+# Usage: replay-check.sh recording.evemu
+
+rec="$1"
+base="${rec%.evemu}"
+replay="${REPLAY:-./synaptics-replay}"
+
+set --
+if [ -f "$base.args" ]; then
+    while IFS= read -r arg; do
+        [ -n "$arg" ] && set -- "$@" "$arg"
+    done < "$base.args"
+fi
+
+actual=$("$replay" "$@" "$rec" 2>/dev/null) || exit 1
+if [ -n "$actual" ]; then
+    printf '%s\n' "$actual"
+fi | diff -u "$base.out" -
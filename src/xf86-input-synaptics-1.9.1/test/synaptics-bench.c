@@ -0,0 +1,421 @@
+/*
+ * Copyright © 2026 The xf86-input-synaptics contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Microbenchmark for the per-report path: synthetic 1-5 finger frames are
+ * fed through ReadInput, i.e. EventReadHwState, SynapticsCopyHwState and
+ * HandleState, and the cost per report is printed for each workload.
+ *
+ * Only the driver's read_input call is timed; generating the frames and
+ * writing them into the pipe is not. Allocations are counted by
+ * interposing the libc allocator, cycles are TSC ticks where available.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "fake-symbols.h"
+
+#define MAX_FINGERS 5
+#define FRAMES_PER_BATCH 64
+#define EVENTS_PER_FRAME (MAX_FINGERS * 4 + 2)
+#define FRAME_INTERVAL_US 8000
+
+/* device ranges of the synthetic pad */
+#define PAD_MAX_X 2033
+#define PAD_MAX_Y 1332
+
+extern InputDriverRec SYNAPTICS;
+
+enum workload_type {
+    WL_HOVER,                   /* resting fingers, only pressure changes */
+    WL_DRAG,                    /* all fingers moving in the move area */
+    WL_SCROLL,                  /* fingers moving along the scroll edge */
+    WL_CLICK,                   /* button-area finger clicking, others resting */
+};
+
+static const char *workload_names[] = { "hover", "drag", "scroll", "click" };
+
+struct frame_buffer {
+    struct input_event events[FRAMES_PER_BATCH * EVENTS_PER_FRAME];
+    size_t nevents;
+    CARD64 time;
+};
+
+/*****************************************************************************
+ * Allocation counting
+ ****************************************************************************/
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static Bool counting;
+static unsigned long allocations;
+
+void *
+malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+/*****************************************************************************
+ * Frame generation
+ ****************************************************************************/
+static void
+add_event(struct frame_buffer *buf, int type, int code, int value)
+{
+    struct input_event *ev = &buf->events[buf->nevents++];
+
+    ev->time.tv_sec = buf->time / 1000000;
+    ev->time.tv_usec = buf->time % 1000000;
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+/* triangle wave so positions stay on the pad however long we run */
+static int
+sweep(int frame, int amplitude)
+{
+    int phase = frame % (2 * amplitude);
+
+    return phase < amplitude ? phase : 2 * amplitude - phase;
+}
+
+static void
+finger_position(enum workload_type type, int finger, int frame,
+                int *x, int *y)
+{
+    switch (type) {
+    case WL_HOVER:
+        *x = 500 + 200 * finger;
+        *y = 400;
+        break;
+    case WL_DRAG:
+        *x = 500 + 200 * finger + sweep(frame, 200);
+        *y = 300 + sweep(frame, 100);
+        break;
+    case WL_SCROLL:
+        *x = PAD_MAX_X - 40;
+        *y = 200 + 150 * finger + sweep(frame, 200);
+        break;
+    case WL_CLICK:
+        /* finger 0 sits in the right button area */
+        *x = finger == 0 ? PAD_MAX_X * 3 / 4 : 500 + 200 * finger;
+        *y = finger == 0 ? PAD_MAX_Y * 9 / 10 : 400;
+        break;
+    }
+}
+
+static void
+add_frame(struct frame_buffer *buf, enum workload_type type, int nfingers,
+          int frame)
+{
+    int f, x, y;
+
+    for (f = 0; f < nfingers; f++) {
+        add_event(buf, EV_ABS, ABS_MT_SLOT, f);
+        if (type == WL_HOVER) {
+            add_event(buf, EV_ABS, ABS_MT_PRESSURE, 40 + sweep(frame + f, 8));
+            continue;
+        }
+        finger_position(type, f, frame, &x, &y);
+        add_event(buf, EV_ABS, ABS_MT_POSITION_X, x);
+        add_event(buf, EV_ABS, ABS_MT_POSITION_Y, y);
+    }
+    if (type == WL_CLICK && frame % 8 == 0)
+        add_event(buf, EV_KEY, BTN_LEFT, (frame / 8) % 2);
+    add_event(buf, EV_SYN, SYN_REPORT, 0);
+    buf->time += FRAME_INTERVAL_US;
+}
+
+static void
+add_touch_frame(struct frame_buffer *buf, enum workload_type type,
+                int nfingers, Bool down)
+{
+    int f, x, y;
+
+    for (f = 0; f < nfingers; f++) {
+        add_event(buf, EV_ABS, ABS_MT_SLOT, f);
+        add_event(buf, EV_ABS, ABS_MT_TRACKING_ID, down ? f : -1);
+        if (!down)
+            continue;
+        finger_position(type, f, 0, &x, &y);
+        add_event(buf, EV_ABS, ABS_MT_POSITION_X, x);
+        add_event(buf, EV_ABS, ABS_MT_POSITION_Y, y);
+        add_event(buf, EV_ABS, ABS_MT_PRESSURE, 40);
+    }
+    if (type == WL_CLICK && !down)
+        add_event(buf, EV_KEY, BTN_LEFT, 0);
+    add_event(buf, EV_SYN, SYN_REPORT, 0);
+    buf->time += FRAME_INTERVAL_US;
+}
+
+/*****************************************************************************
+ * Benchmark driver
+ ****************************************************************************/
+static void
+setup_device(void)
+{
+    static const int abs_codes[] = {
+        ABS_X, ABS_Y, ABS_PRESSURE, ABS_MT_SLOT, ABS_MT_POSITION_X,
+        ABS_MT_POSITION_Y, ABS_MT_TRACKING_ID, ABS_MT_PRESSURE
+    };
+    static const int abs_max[] = {
+        PAD_MAX_X, PAD_MAX_Y, 255, MAX_FINGERS - 1, PAD_MAX_X,
+        PAD_MAX_Y, 65535, 255
+    };
+    size_t i;
+
+    fake_evdev_set_name("synaptics-bench touchpad");
+    fake_evdev_enable_property(INPUT_PROP_POINTER);
+    fake_evdev_enable_property(INPUT_PROP_BUTTONPAD);
+    fake_evdev_enable_event_code(EV_KEY, BTN_LEFT);
+    fake_evdev_enable_event_code(EV_KEY, BTN_TOUCH);
+    fake_evdev_enable_event_code(EV_KEY, BTN_TOOL_FINGER);
+    fake_evdev_enable_event_code(EV_KEY, BTN_TOOL_DOUBLETAP);
+    fake_evdev_enable_event_code(EV_KEY, BTN_TOOL_TRIPLETAP);
+    for (i = 0; i < sizeof(abs_codes) / sizeof(abs_codes[0]); i++) {
+        struct input_absinfo abs = { 0 };
+
+        abs.maximum = abs_max[i];
+        if (abs_codes[i] == ABS_X || abs_codes[i] == ABS_Y ||
+            abs_codes[i] == ABS_MT_POSITION_X ||
+            abs_codes[i] == ABS_MT_POSITION_Y)
+            abs.resolution = 20;
+        fake_evdev_set_abs_info(abs_codes[i], &abs);
+    }
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+feed(InputInfoPtr pInfo, int fd, struct frame_buffer *buf)
+{
+    if (write(fd, buf->events, buf->nevents * sizeof(struct input_event)) < 0) {
+        perror("write");
+        return -1;
+    }
+    fake_set_time(buf->time);
+    buf->nevents = 0;
+    return 0;
+}
+
+static int
+run_workload(InputInfoPtr pInfo, int fd, enum workload_type type,
+             int nfingers, long nreports)
+{
+    struct frame_buffer *buf = calloc(1, sizeof(*buf));
+    double ns = 0;
+    unsigned long long cycles = 0;
+    unsigned long allocs = 0;
+    long reports = 0;
+    int frame = 0;
+
+    if (!buf)
+        return -1;
+
+    add_touch_frame(buf, type, nfingers, TRUE);
+    if (feed(pInfo, fd, buf) < 0)
+        goto fail;
+    pInfo->read_input(pInfo);
+
+    while (reports < nreports) {
+        double start;
+        int i;
+#ifdef HAVE_TSC
+        unsigned long long tsc;
+#endif
+
+        for (i = 0; i < FRAMES_PER_BATCH && reports + i < nreports; i++)
+            add_frame(buf, type, nfingers, frame++);
+        if (feed(pInfo, fd, buf) < 0)
+            goto fail;
+
+        allocations = 0;
+        counting = TRUE;
+        start = now_ns();
+#ifdef HAVE_TSC
+        tsc = __rdtsc();
+#endif
+        pInfo->read_input(pInfo);
+#ifdef HAVE_TSC
+        cycles += __rdtsc() - tsc;
+#endif
+        ns += now_ns() - start;
+        counting = FALSE;
+        allocs += allocations;
+        reports += i;
+    }
+
+    add_touch_frame(buf, type, nfingers, FALSE);
+    if (feed(pInfo, fd, buf) < 0)
+        goto fail;
+    pInfo->read_input(pInfo);
+
+    printf("%-8s %7d %10ld %12.1f", workload_names[type], nfingers, reports,
+           ns / reports);
+#ifdef HAVE_TSC
+    printf(" %14.1f", (double) cycles / reports);
+#else
+    printf(" %14s", "n/a");
+#endif
+    printf(" %14.3f\n", (double) allocs / reports);
+
+    free(buf);
+    return 0;
+
+ fail:
+    free(buf);
+    return -1;
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+            "Usage: synaptics-bench [-n reports] [workload]...\n"
+            "  -n    reports per workload and finger count (default 200000)\n"
+            "  workloads: hover, drag, scroll, click (default: all)\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    InputInfoRec info = { 0 };
+    DeviceIntRec dev = { 0 };
+    Bool selected[sizeof(workload_names) / sizeof(workload_names[0])] = { 0 };
+    Bool any_selected = FALSE;
+    long nreports = 200000;
+    int fds[2];
+    int opt, i, f, rc = 1;
+
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            nreports = atol(optarg);
+            break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+
+    if (nreports <= 0) {
+        usage();
+        return 1;
+    }
+
+    for (; optind < argc; optind++) {
+        for (i = 0; i <= WL_CLICK; i++)
+            if (strcmp(argv[optind], workload_names[i]) == 0)
+                break;
+        if (i > WL_CLICK) {
+            usage();
+            return 1;
+        }
+        selected[i] = any_selected = TRUE;
+    }
+
+    if (pipe(fds) < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    fake_serial_fd = fds[0];
+    setup_device();
+
+    info.name = "synaptics-bench";
+    info.dev = &dev;
+    dev.public.devicePrivate = &info;
+    info.options = xf86AddNewOption(info.options, "Protocol", "event");
+    info.options = xf86AddNewOption(info.options, "Device", "synaptics-bench");
+
+    if (SYNAPTICS.PreInit(&SYNAPTICS, &info, 0) != Success) {
+        fprintf(stderr, "PreInit failed\n");
+        return 1;
+    }
+    if (info.device_control(&dev, DEVICE_INIT) != Success ||
+        info.device_control(&dev, DEVICE_ON) != Success) {
+        fprintf(stderr, "Failed to enable the device\n");
+        goto out;
+    }
+
+    printf("%-8s %7s %10s %12s %14s %14s\n", "workload", "fingers",
+           "reports", "ns/report", "cycles/report", "allocs/report");
+
+    for (i = 0; i <= WL_CLICK; i++) {
+        if (any_selected && !selected[i])
+            continue;
+        for (f = 1; f <= MAX_FINGERS; f++)
+            if (run_workload(&info, fds[1], i, f, nreports) < 0)
+                goto out;
+    }
+    rc = 0;
+
+ out:
+    info.device_control(&dev, DEVICE_OFF);
+    info.device_control(&dev, DEVICE_CLOSE);
+    SYNAPTICS.UnInit(&SYNAPTICS, &info, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    return rc;
+}
@@ -0,0 +1,353 @@
+/*
+ * Copyright © 2026 The xf86-input-synaptics contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replays an evemu recording through the driver without an X server.
+ *
+ * The recording's device description is handed to the fake libevdev, the
+ * events are written frame by frame into a pipe that the driver reads
+ * through EventReadHwState(), and everything HandleState() posts is dumped
+ * to stdout, one event per line:
+ *
+ *     <millis> motion a0=<dx> a1=<dy> a2=<hscroll> a3=<vscroll>
+ *     <millis> button <n> press|release
+ *
+ * followed by the properties asked for with -g, as read by a client.
+ * Two runs against different driver builds can be diffed directly.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fake-symbols.h"
+
+#define MAX_OPTIONS 32
+
+extern InputDriverRec SYNAPTICS;
+
+struct recording {
+    struct input_event *events;
+    size_t nevents;
+    size_t size;
+};
+
+static void
+usage(void)
+{
+    fprintf(stderr,
+            "Usage: synaptics-replay [-q] [-t ms] [-o Option=value]... "
+            "[-p \"Property=v1,v2\"]... [-g Property]... recording\n"
+            "  -q    don't dump posted events, only print statistics\n"
+            "  -t    keep firing timers for ms after the last event "
+            "(default 1000)\n"
+            "  -o    set a driver option as if from xorg.conf\n"
+            "  -p    set a device property after the device is enabled\n"
+            "  -g    print a device property after the replay\n");
+}
+
+static int
+add_event(struct recording *rec, const struct input_event *ev)
+{
+    if (rec->nevents == rec->size) {
+        size_t size = rec->size ? rec->size * 2 : 4096;
+        struct input_event *events;
+
+        events = realloc(rec->events, size * sizeof(*events));
+        if (!events)
+            return -ENOMEM;
+        rec->events = events;
+        rec->size = size;
+    }
+
+    rec->events[rec->nevents++] = *ev;
+    return 0;
+}
+
+/* B: and P: lines are byte masks split over several lines */
+static void
+parse_bits(const char *line, unsigned int type, unsigned int *offset)
+{
+    const char *s = line;
+    int n;
+    unsigned int byte;
+
+    while (sscanf(s, "%x%n", &byte, &n) == 1) {
+        int bit;
+
+        for (bit = 0; bit < 8; bit++) {
+            if (!(byte & (1 << bit)))
+                continue;
+            if (type == EV_MAX + 1)
+                fake_evdev_enable_property(*offset * 8 + bit);
+            else if (type == EV_SYN)
+                fake_evdev_enable_event_code(*offset * 8 + bit, 0);
+            else
+                fake_evdev_enable_event_code(type, *offset * 8 + bit);
+        }
+        (*offset)++;
+        s += n;
+    }
+}
+
+static int
+load_recording(const char *path, struct recording *rec)
+{
+    FILE *fp = fopen(path, "r");
+    char line[1024];
+    unsigned int bits_type = EV_CNT, bits_offset = 0, prop_offset = 0;
+
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        struct input_event ev;
+        struct input_absinfo abs = { 0 };
+        unsigned long sec, usec;
+        unsigned int type, code;
+        int value, n;
+
+        if (strncmp(line, "N: ", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            fake_evdev_set_name(line + 3);
+        }
+        else if (strncmp(line, "P: ", 3) == 0) {
+            parse_bits(line + 3, EV_MAX + 1, &prop_offset);
+        }
+        else if (sscanf(line, "B: %x%n", &type, &n) == 1) {
+            if (type != bits_type) {
+                bits_type = type;
+                bits_offset = 0;
+            }
+            parse_bits(line + n, type, &bits_offset);
+        }
+        else if (sscanf(line, "A: %x %d %d %d %d %d", &code, &abs.minimum,
+                        &abs.maximum, &abs.fuzz, &abs.flat,
+                        &abs.resolution) >= 5) {
+            fake_evdev_set_abs_info(code, &abs);
+        }
+        else if (sscanf(line, "E: %lu.%lu %x %x %d", &sec, &usec, &type,
+                        &code, &value) == 5) {
+            memset(&ev, 0, sizeof(ev));
+            ev.time.tv_sec = sec;
+            ev.time.tv_usec = usec;
+            ev.type = type;
+            ev.code = code;
+            ev.value = value;
+            if (add_event(rec, &ev) < 0) {
+                fclose(fp);
+                return -1;
+            }
+        }
+    }
+
+    fclose(fp);
+
+    if (rec->nevents == 0) {
+        fprintf(stderr, "%s: no events found\n", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static CARD64
+event_time(const struct input_event *ev)
+{
+    return (CARD64) ev->time.tv_sec * 1000000 + ev->time.tv_usec;
+}
+
+static double
+elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int
+main(int argc, char **argv)
+{
+    InputInfoRec info = { 0 };
+    DeviceIntRec dev = { 0 };
+    struct recording rec = { 0 };
+    char *props[MAX_OPTIONS];
+    int nprops = 0;
+    char *gets[MAX_OPTIONS];
+    int ngets = 0;
+    int tail = 1000;
+    int fds[2];
+    size_t i, frames = 0;
+    struct timespec start, end;
+    double secs;
+    int opt, rc = 1;
+
+    fake_event_log = stdout;
+
+    while ((opt = getopt(argc, argv, "qt:o:p:g:h")) != -1) {
+        char *value;
+
+        switch (opt) {
+        case 'q':
+            fake_event_log = NULL;
+            break;
+        case 't':
+            tail = atoi(optarg);
+            break;
+        case 'o':
+            value = strchr(optarg, '=');
+            if (!value) {
+                usage();
+                return 1;
+            }
+            *value++ = '\0';
+            info.options = xf86AddNewOption(info.options, optarg, value);
+            break;
+        case 'p':
+            if (nprops == MAX_OPTIONS || !strchr(optarg, '=')) {
+                usage();
+                return 1;
+            }
+            props[nprops++] = optarg;
+            break;
+        case 'g':
+            if (ngets == MAX_OPTIONS) {
+                usage();
+                return 1;
+            }
+            gets[ngets++] = optarg;
+            break;
+        default:
+            usage();
+            return opt != 'h';
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage();
+        return 1;
+    }
+
+    if (load_recording(argv[optind], &rec) < 0)
+        return 1;
+
+    if (pipe(fds) < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    fake_serial_fd = fds[0];
+    fake_set_time(event_time(&rec.events[0]));
+
+    info.name = "synaptics-replay";
+    info.dev = &dev;
+    dev.public.devicePrivate = &info;
+    info.options = xf86AddNewOption(info.options, "Protocol", "event");
+    info.options = xf86AddNewOption(info.options, "Device", argv[optind]);
+
+    if (SYNAPTICS.PreInit(&SYNAPTICS, &info, 0) != Success) {
+        fprintf(stderr, "PreInit failed\n");
+        return 1;
+    }
+    if (info.device_control(&dev, DEVICE_INIT) != Success ||
+        info.device_control(&dev, DEVICE_ON) != Success) {
+        fprintf(stderr, "Failed to enable the device\n");
+        goto out;
+    }
+
+    for (opt = 0; opt < nprops; opt++) {
+        char *value = strchr(props[opt], '=');
+
+        *value++ = '\0';
+        if (fake_set_property(&dev, props[opt], value) != Success) {
+            fprintf(stderr, "Failed to set property %s\n", props[opt]);
+            goto out;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < rec.nevents;) {
+        size_t first = i;
+
+        /* one frame per read, like the kernel delivers them */
+        while (i < rec.nevents) {
+            const struct input_event *ev = &rec.events[i++];
+
+            if (ev->type == EV_SYN &&
+                (ev->code == SYN_REPORT || ev->code == SYN_DROPPED))
+                break;
+        }
+
+        fake_set_time(event_time(&rec.events[i - 1]));
+        fake_run_timers();
+
+        if (write(fds[1], &rec.events[first],
+                  (i - first) * sizeof(struct input_event)) < 0) {
+            perror("write");
+            goto out;
+        }
+        info.read_input(&info);
+        frames++;
+    }
+
+    fake_set_time(fake_get_time() + tail * 1000ULL);
+    fake_run_timers();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    secs = elapsed(&start, &end);
+
+    for (opt = 0; opt < ngets; opt++) {
+        if (fake_print_property(&dev, gets[opt], stdout) != Success) {
+            fprintf(stderr, "Failed to get property %s\n", gets[opt]);
+            goto out;
+        }
+    }
+
+    fprintf(stderr, "%zu frames, %zu input events, %lu posted events "
+            "in %.3f s (%.0f input events/s, %.0f frames/s)\n",
+            frames, rec.nevents, fake_events_posted, secs,
+            secs > 0 ? rec.nevents / secs : 0, secs > 0 ? frames / secs : 0);
+    rc = 0;
+
+ out:
+    if (fake_event_log)
+        fflush(fake_event_log);
+    info.device_control(&dev, DEVICE_OFF);
+    info.device_control(&dev, DEVICE_CLOSE);
+    SYNAPTICS.UnInit(&SYNAPTICS, &info, 0);
+    close(fds[0]);
+    close(fds[1]);
+    free(rec.events);
+
+    return rc;
+}